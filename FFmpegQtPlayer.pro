@@ -27,27 +27,65 @@ SOURCES += \
         main.cpp \
         mainwindow.cpp \
     avpacketqueue.cpp \
+    framequeue.cpp \
+    videofilter.cpp \
+    audioringbuffer.cpp \
+    mediaclock.cpp \
+    keyframeindex.cpp \
+    readaheadio.cpp \
+    thumbnailprovider.cpp \
+    stagecounter.cpp \
+    tracer.cpp \
     audiodecoder.cpp \ 
-    maindecoder.cpp
-
-INCLUDEPATH += $$PWD/ffmpeg/include \
-                $$PWD/sdl/include
-
-LIBS    += $$PWD/ffmpeg/lib/avcodec.lib \
-            $$PWD/ffmpeg/lib/avdevice.lib \
-            $$PWD/ffmpeg/lib/avfilter.lib \
-            $$PWD/ffmpeg/lib/avformat.lib \
-            $$PWD/ffmpeg/lib/avutil.lib \
-            $$PWD/ffmpeg/lib/postproc.lib \
-            $$PWD/ffmpeg/lib/swresample.lib \
-            $$PWD/ffmpeg/lib/swscale.lib \
-            $$PWD/sdl/lib/libSDL2.a
+    maindecoder.cpp \
+    headlessrunner.cpp \
+    synctestrunner.cpp
+
+# Windows 使用随工程附带的 FFmpeg / SDL；Linux（无界面测试机）使用系统安装的库
+win32 {
+    INCLUDEPATH += $$PWD/ffmpeg/include \
+                    $$PWD/sdl/include
+
+    LIBS    += $$PWD/ffmpeg/lib/avcodec.lib \
+                $$PWD/ffmpeg/lib/avdevice.lib \
+                $$PWD/ffmpeg/lib/avfilter.lib \
+                $$PWD/ffmpeg/lib/avformat.lib \
+                $$PWD/ffmpeg/lib/avutil.lib \
+                $$PWD/ffmpeg/lib/postproc.lib \
+                $$PWD/ffmpeg/lib/swresample.lib \
+                $$PWD/ffmpeg/lib/swscale.lib \
+                $$PWD/sdl/lib/libSDL2.a
+}
+
+unix {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libavcodec libavdevice libavfilter libavformat libavutil libswresample libswscale sdl2
+}
+
+# 管线活动追踪（Chrome trace 导出），qmake CONFIG+=trace 开启
+trace {
+    DEFINES += ENABLE_TRACE
+}
+
+# 无界面性能测试读取峰值内存
+win32: LIBS += -lpsapi
 
 HEADERS += \
         mainwindow.h \
     avpacketqueue.h \
+    framequeue.h \
+    videofilter.h \
+    audioringbuffer.h \
+    mediaclock.h \
+    keyframeindex.h \
+    readaheadio.h \
+    thumbnailprovider.h \
+    stagecounter.h \
+    tracer.h \
     audiodecoder.h \ 
-    maindecoder.h
+    maindecoder.h \
+    headlessrunner.h \
+    synctestrunner.h
 
 FORMS += \
         mainwindow.ui
@@ -1,23 +1,47 @@
 ﻿#include <QDebug>
 
 #include "audiodecoder.h"
+#include "tracer.h"
 
 /* Minimum SDL audio buffer size, in samples. */
 #define SDL_AUDIO_MIN_BUFFER_SIZE 512
 /* Calculate actual buffer size keeping in mind not cause too frequent audio callbacks */
 #define SDL_AUDIO_MAX_CALLBACKS_PER_SEC 30
 
+/* PCM 环形缓冲区容量（秒），解码线程领先播放的最大时长 */
+#define AUDIO_PCM_BUFFER_SECONDS    0.5
+/* 音频回调读取写入进度的最大尝试次数，仍读不到一致的记录时本周期不更新时钟 */
+#define AUDIO_WRITE_READ_RETRIES    4
+
 AudioDecoder::AudioDecoder(QObject *parent) :
     QObject(parent),
     isStop(false),
     isPause(false),
-    isreadFinished(false),
+    isFreeRun(false),
+    seekTarget(AV_NOPTS_VALUE),
     totalTime(0),
-    clock(0),
     volume(SDL_MIX_MAXVOLUME),
+    clockSeq(0),
+    clockPts(0),
+    clockTime(0),
+    clockMax(0),
+    clockFrozen(0),
+    clockPinned(0),
+    deviceLatency(0),
+    outputTap(nullptr),
+    outputTapOpaque(nullptr),
+    writeSeq(0),
+    writeEndPts(0),
+    writeEndPos(0),
+    writeSerial(-1),
+    writeClock(0),
+    mixBuf(nullptr),
+    bytesPerSec(0),
+    decodeTid(nullptr),
     audioDeviceFormat(AUDIO_F32SYS),
     aCovertCtx(NULL),
-    sendReturn(0)
+    audioSerial(-1),
+    discardTarget(AV_NOPTS_VALUE)
 {
 
 }
@@ -43,7 +67,6 @@ int AudioDecoder::openAudio(AVFormatContext *pFormatCtx, int index)
     // 重置播放控制状态
     isStop = false;
     isPause = false;
-    isreadFinished = false;
 
     // 重置重采样源参数（由解码出的数据包决定）
     audioSrcFmt = AV_SAMPLE_FMT_NONE;
@@ -53,6 +76,7 @@ int AudioDecoder::openAudio(AVFormatContext *pFormatCtx, int index)
     // 允许该流被正常处理
     pFormatCtx->streams[index]->discard = AVDISCARD_DEFAULT;
     stream = pFormatCtx->streams[index];
+    packetQueue.setTimeBase(stream->time_base);
 
     // 1. 初始化解码器上下文并拷贝流参数
     codecCtx = avcodec_alloc_context3(NULL);
@@ -159,7 +183,19 @@ int AudioDecoder::openAudio(AVFormatContext *pFormatCtx, int index)
     default:           audioDstFmt = AV_SAMPLE_FMT_S16; audioDepth = 2; break;
     }
 
-    // 7. 取消静音，音频设备正式开始工作（触发 Callback）
+    bytesPerSec = spec.freq * spec.channels * audioDepth;
+
+    // 8. 分配 PCM 缓冲区和回调中调节音量用的暂存区，回调里不再分配内存
+    pcmBuffer.allocate(FFMAX(static_cast<int>(bytesPerSec * AUDIO_PCM_BUFFER_SECONDS), static_cast<int>(sizeof(audioBuf1))));
+    mixBuf = new quint8[spec.size];
+
+    // 9. 启动解码线程，解码和重采样都在这里完成
+    audioSerial = -1;
+    writeClock  = 0;
+    writeSerial = -1;
+    decodeTid = SDL_CreateThread(&AudioDecoder::decodeThread, "audio_decode", this);
+
+    // 10. 取消静音，音频设备正式开始工作（触发 Callback）
     SDL_PauseAudio(0);
 
     return 0;
@@ -168,6 +204,16 @@ int AudioDecoder::openAudio(AVFormatContext *pFormatCtx, int index)
 // 关闭音频解码
 void AudioDecoder::closeAudio()
 {
+    // 通知解码线程退出并等待，之后才能释放解码器和缓冲区
+    isStop = true;
+    packetQueue.abort();
+    pcmBuffer.wakeWriter();
+
+    if (decodeTid) {
+        SDL_WaitThread(decodeTid, NULL);
+        decodeTid = nullptr;
+    }
+
     emptyAudioData();
 
     SDL_LockAudio();
@@ -176,24 +222,45 @@ void AudioDecoder::closeAudio()
 
     avcodec_close(codecCtx);
     avcodec_free_context(&codecCtx);
-}
 
-// 文件读取完成
-void AudioDecoder::readFileFinished()
-{
-    isreadFinished = true;
+    if (aCovertCtx) {
+        swr_free(&aCovertCtx);
+    }
+
+    pcmBuffer.release();
+    delete[] mixBuf;
+    mixBuf = nullptr;
 }
 
 // 暂停/开始播放
 void AudioDecoder::pauseAudio(bool pause)
 {
+    if (pause) {
+        // 暂停音频设备，暂停期间 SDL 不再调用回调函数
+        SDL_PauseAudio(1);
+    }
+
+    // 时钟停在当前位置；恢复时从当前时刻重新外推，直到下一次回调更新
+    qint64 pts = static_cast<qint64>(getAudioClock() * AV_TIME_BASE);
+
     isPause = pause;
+
+    SDL_LockAudio();
+    publishClock(pts, av_gettime_relative(), pts, pause);
+    SDL_UnlockAudio();
+
+    if (!pause) {
+        SDL_PauseAudio(0);
+    }
 }
 
 // 停止播放
 void AudioDecoder::stopAudio()
 {
     isStop = true;
+
+    // 唤醒等待缓冲区空间的解码线程（暂停时音频回调不再读取，不会唤醒它）
+    pcmBuffer.wakeWriter();
 }
 
 // 原始帧入队
@@ -202,27 +269,82 @@ void AudioDecoder::packetEnqueue(AVPacket *packet)
     packetQueue.enqueue(packet);
 }
 
-// 清空音频缓存
+// 音频原始帧队列，供解复用线程设置容量与等待空间
+AvPacketQueue *AudioDecoder::getPacketQueue()
+{
+    return &packetQueue;
+}
+
+// 清空音频缓存（解复用线程在跳转或开始播放前调用）
 void AudioDecoder::emptyAudioData()
 {
-    audioBuf = nullptr;
+    setClock(0);
 
-    audioBufIndex = 0;
-    audioBufSize = 0;
-    audioBufSize1 = 0;
+    // 序列号加一，解码线程据此丢弃跳转之前的残留数据
+    packetQueue.flush();
 
-    clock = 0;
+    // 丢弃已解码还没播放的数据，解码线程收到新序列的第一个包时还会再丢弃一次
+    pcmBuffer.discard();
+}
 
-    sendReturn = 0;
+// 跳转后设置时钟，新数据开始播放之前时钟停在该位置
+void AudioDecoder::setClock(double clk)
+{
+    qint64 pts = static_cast<qint64>(clk * AV_TIME_BASE);
 
-    packetQueue.empty();
+    // 与音频回调互斥，保证同一时刻只有一个写者
+    SDL_LockAudio();
+    publishClock(pts, av_gettime_relative(), pts, isPause);
+    clockPinned = 1;
+    SDL_UnlockAudio();
+}
 
-    isreadFinished = false;
+/**
+ * @brief 音频时钟是否在按播放的数据走时（任意线程）
+ * @return false 跳转或开始播放后，新序列的数据还没有交给设备，时钟停在 setClock() 设置的位置
+ */
+bool AudioDecoder::isClockRunning()
+{
+    return !clockPinned.loadAcquire();
 }
 
-void AudioDecoder::setClock(double clk)
+/**
+ * @brief 设置额外的设备输出延迟，SDL 无法得知的延迟（如蓝牙耳机、外接功放）由使用者校准
+ * @param latency 延迟（秒），时钟会相应减去该值
+ */
+void AudioDecoder::setDeviceLatency(double latency)
+{
+    deviceLatency.storeRelease(static_cast<qint64>(latency * AV_TIME_BASE));
+}
+
+/**
+ * @brief 全速运行（性能测试用）：解码和重采样不受设备播放速度限制，
+ *        缓冲区放不下的数据直接丢弃，设备只播放来得及播放的部分
+ */
+void AudioDecoder::setFreeRun(bool freeRun)
 {
-    clock = clk;
+    isFreeRun = freeRun;
+}
+
+/**
+ * @brief 设置输出监听（测试用），传入 nullptr 取消
+ * @note  监听到的是调节音量后实际交给设备的数据，时刻为回调被调用的原始时刻，不经过音频时钟的延迟模型
+ */
+void AudioDecoder::setOutputTap(OutputTap tap, void *opaque)
+{
+    SDL_LockAudio();
+    outputTap       = tap;
+    outputTapOpaque = opaque;
+    SDL_UnlockAudio();
+}
+
+/**
+ * @brief 设置精确跳转的目标（微秒），解码线程在新序列中丢弃目标之前的采样，AV_NOPTS_VALUE 表示不丢弃
+ * @note  需在 emptyAudioData() 使序列号加一之前设置
+ */
+void AudioDecoder::setSeekTarget(qint64 target)
+{
+    seekTarget = target;
 }
 
 int AudioDecoder::getVolume()
@@ -235,26 +357,115 @@ void AudioDecoder::setVolume(int volume)
     this->volume = volume;
 }
 
+/**
+ * @brief 当前正在播放的音频时间（秒），任意线程可无锁调用，不修改任何状态
+ * @note  由最近一次回调记录的时间点按单调时钟外推，最多外推到已交给设备的数据末尾
+ */
 double AudioDecoder::getAudioClock()
 {
-    if (codecCtx) {
-        /* control audio pts according to audio buffer data size */
-        // 缓冲区中还没播放的数据量（字节）
-        int hwBufSize   = audioBufSize - audioBufIndex;
-        // 每秒消耗的字节数（采样率×通道数×位深）
-        int bytesPerSec = codecCtx->sample_rate * codecCtx->channels * audioDepth;
-        // 因为clock是缓冲区中全部数据最后的时间，部分数据还没播放，所以需要减去剩下数据播放所需的时间
-        clock -= static_cast<double>(hwBufSize) / bytesPerSec;
+    int seq;
+    qint64 pts, time, maxPts;
+    bool isFrozen;
+
+    while (1) {
+        seq = clockSeq.loadAcquire();
+        if (seq & 1) {
+            // 写者正在更新
+            continue;
+        }
+
+        pts         = clockPts.loadAcquire();
+        time        = clockTime.loadAcquire();
+        maxPts      = clockMax.loadAcquire();
+        isFrozen    = clockFrozen.loadAcquire();
+
+        if (seq == clockSeq.loadAcquire()) {
+            break;
+        }
+    }
+
+    if (!isFrozen) {
+        pts = FFMIN(pts + av_gettime_relative() - time, maxPts);
+    }
+
+    return static_cast<double>(pts) / AV_TIME_BASE;
+}
+
+// 发布时钟记录，调用者需保证同一时刻只有一个写者（音频回调，或持有 SDL_LockAudio() 的线程）
+void AudioDecoder::publishClock(qint64 pts, qint64 time, qint64 maxPts, bool isFrozen)
+{
+    clockSeq.fetchAndAddOrdered(1);
+    clockPts.storeRelease(pts);
+    clockTime.storeRelease(time);
+    clockMax.storeRelease(maxPts);
+    clockFrozen.storeRelease(isFrozen);
+    clockSeq.fetchAndAddOrdered(1);
+}
+
+// 解码线程写完一帧后发布写入进度：数据末尾的 pts 及其在缓冲区中的累计位置
+void AudioDecoder::publishWritten(double endPts, int serial)
+{
+    writeSeq.fetchAndAddOrdered(1);
+    writeEndPts.storeRelease(static_cast<qint64>(endPts * AV_TIME_BASE));
+    writeEndPos.storeRelease(pcmBuffer.writePosition());
+    writeSerial.storeRelease(serial);
+    writeSeq.fetchAndAddOrdered(1);
+}
+
+/**
+ * @brief 音频回调中更新时钟
+ * @param size         本次回调拷贝的有效数据字节数（不含补的静音）
+ * @param callbackTime 回调开始的时刻
+ * @note  本次拷贝的数据排在设备中约一个周期（spec.size）的数据之后播放，
+ *        所以回调时刻正在播放的位置 = 拷贝数据末尾的 pts - (size + spec.size) / bytesPerSec - 额外延迟。
+ *        解码线程可能在发布写入进度的中途被抢占，回调不能无限等它：尝试几次仍读不到一致的记录时，
+ *        本周期保持之前发布的时钟（按单调时钟继续外推），下一次回调再更新
+ */
+void AudioDecoder::updateClock(int size, qint64 callbackTime)
+{
+    int seq;
+    qint64 endPts = 0;
+    quint32 endPos = 0;
+    int serial = -1;
+    bool isConsistent = false;
+
+    for (int i = 0; i < AUDIO_WRITE_READ_RETRIES && !isConsistent; i++) {
+        seq = writeSeq.loadAcquire();
+        if (seq & 1) {
+            continue;
+        }
+
+        endPts  = writeEndPts.loadAcquire();
+        endPos  = writeEndPos.loadAcquire();
+        serial  = writeSerial.loadAcquire();
+
+        isConsistent = seq == writeSeq.loadAcquire();
+    }
+
+    if (!isConsistent) {
+        return;
+    }
 
+    // 跳转后还没有写入新序列的数据，保持 setClock() 设置的时间
+    if (serial != packetQueue.serial()) {
+        return;
     }
 
-    return clock;
+    // 读位置之后已写入的字节数（可能为负：解码线程写了数据但还没发布进度），据此换算读位置的 pts
+    qint32 pending = static_cast<qint32>(endPos - pcmBuffer.readPosition());
+    qint64 readPts = endPts - static_cast<qint64>(pending) * AV_TIME_BASE / bytesPerSec;
+
+    qint64 latency = deviceLatency.loadAcquire();
+    qint64 playingPts = readPts - static_cast<qint64>(size + spec.size) * AV_TIME_BASE / bytesPerSec - latency;
+
+    publishClock(playingPts, callbackTime, readPts - latency, false);
+    clockPinned.storeRelease(0);
 }
 
 /**
  * @brief  SDL 音频播放回调函数。
- * @note   此函数由 SDL 内部音频线程异步定时调用。其核心任务是“填满” SDL 提供的缓冲区。
- * 如果解码后的数据多于请求量，则缓存剩余部分；如果少于请求量，则触发解码流程。
+ * @note   此函数由 SDL 内部音频线程异步定时调用。只从 PCM 缓冲区拷贝数据并调节音量，
+ * 解码和重采样都在解码线程中完成。数据不足时补静音，不等待。
  * * @param  userdata  指向 AudioDecoder 实例的指针（在 SDL_OpenAudio 中通过 wantedSpec.userdata 传入）。
  * @param  stream    SDL 硬件缓冲区的起始地址，用于接收 PCM 数据。
  * @param  len       SDL 本次请求填充的字节总数。
@@ -264,133 +475,172 @@ double AudioDecoder::getAudioClock()
 void AudioDecoder::audioCallback(void *userdata, quint8 *stream, int SDL_AudioBufSize)
 {
     AudioDecoder *decoder = (AudioDecoder *)userdata;
+    int size = 0;
+    qint64 callbackTime = av_gettime_relative();
+
+    TRACE_THREAD_NAME("sdl_audio");
+    TRACE_SCOPE("audio_callback");
 
-    // 解码数据大小
-    int decodedSize;
-    /* SDL_BufSize means audio play buffer left size
-     * while it greater than 0, means counld fill data to it
-     */
-    while (SDL_AudioBufSize > 0) {
-        if (decoder->isStop) {
-            return ;
+    if (!decoder->isStop && !decoder->isPause) {
+        if (decoder->volume == SDL_MIX_MAXVOLUME) {
+            // 原始音量，直接拷贝到硬件缓冲区
+            size = decoder->pcmBuffer.read(stream, SDL_AudioBufSize);
+        } else {
+            // 先拷贝到暂存区，再使用 SDL_MixAudio 混入静音的硬件缓冲区并应用音量
+            size = decoder->pcmBuffer.read(decoder->mixBuf, FFMIN(SDL_AudioBufSize, static_cast<int>(decoder->spec.size)));
+            memset(stream, 0, size);
+            SDL_MixAudio(stream, decoder->mixBuf, size, decoder->volume);
         }
+    }
 
-        if (decoder->isPause) {
-            SDL_Delay(10);
-            continue;
+    // 数据不足的部分输出静音，防止声卡发出爆鸣声
+    if (size < SDL_AudioBufSize) {
+        memset(stream + size, 0, SDL_AudioBufSize - size);
+    }
+
+    if (!decoder->isStop && !decoder->isPause) {
+        decoder->updateClock(size, callbackTime);
+
+        if (decoder->outputTap) {
+            decoder->outputTap(decoder->outputTapOpaque, &decoder->spec, stream, SDL_AudioBufSize, callbackTime);
         }
+    }
+}
+
+/**
+ * @brief 音频解码线程：从包队列取包解码、重采样，写入 PCM 缓冲区
+ * @note  文件读完（包队列被 abort 且已取空）后冲刷解码器，等缓冲区中的数据播放完再通知播放结束
+ */
+int AudioDecoder::decodeThread(void *arg)
+{
+    AudioDecoder *decoder = (AudioDecoder *)arg;
+    AVPacket packet;
+    AVFrame *frame = av_frame_alloc();
+    int serial;
+    int ret;
+
+    TRACE_THREAD_NAME("audio_decode");
+
+    while (!decoder->isStop) {
+        if (!decoder->packetQueue.dequeue(&packet, true, &serial)) {
+            if (decoder->isStop) {
+                break;
+            }
+
+            // 文件读完：送入空包取出解码器中剩余的帧
+            if (decoder->audioSerial == decoder->packetQueue.serial()) {
+                avcodec_send_packet(decoder->codecCtx, NULL);
+                decoder->receiveFrames(frame, decoder->audioSerial);
+            }
 
-        /* no data in buffer */
-        // 如果当前索引 (audioBufIndex) 大于等于缓冲区总大小，说明上一帧数据已播完
-        if (decoder->audioBufIndex >= decoder->audioBufSize) {
-
-            // 解码
-            decodedSize = decoder->decodeAudio();
-            /* if error, just output silence */
-            if (decodedSize < 0) {
-                // 解码失败或没有数据：生成 1024 字节的伪缓冲区并设为 nullptr
-                // 这将导致下方逻辑输出“静音”，防止声卡发出爆鸣声
-                decoder->audioBufSize = 1024;
-                decoder->audioBuf = nullptr;
-            } else {
-                decoder->audioBufSize = decodedSize;
+            // 等待缓冲区中的数据播放完，期间发生跳转则回到解码循环
+            if (decoder->waitForDrain()) {
+                // 通知解码器音频已播放完
+                emit decoder->playFinished();
+                break;
             }
-            // 重置读取进度索引
-            decoder->audioBufIndex = 0;
+
+            continue;
         }
 
-        /* calculate number of data that haven't play */
-        // 暂存播放区里还没有播放的数据大小
-        int left = decoder->audioBufSize - decoder->audioBufIndex;
-        // 如果库存比 SDL 想要的多，则只搬运 SDL 想要的大小
-        if (left > SDL_AudioBufSize) {
-            left = SDL_AudioBufSize;
+        // 跳转之前读入的旧包，直接丢弃
+        if (serial != decoder->packetQueue.serial()) {
+            av_packet_unref(&packet);
+            continue;
         }
 
-        if (decoder->audioBuf) {
-            // 先清空目标区域（stream 是待填充的原始硬件内存）
-            memset(stream, 0, left);
-            // 使用 SDL_MixAudio 进行混音并应用音量控制 (decoder->volume)
-            // 相比 memcpy，这能提供更平滑的音量缩放，避免直接修改原始 PCM 导致爆音
-            SDL_MixAudio(stream, decoder->audioBuf + decoder->audioBufIndex, left, decoder->volume);
-        } else {
-            // 明确告诉硬件：这一段没数据，请保持安静
-            memset(stream, 0, left);
+        if (serial != decoder->audioSerial) {
+            // 新播放序列的第一个包：清空一次解码器缓冲区和缓冲区中残留的旧数据
+            avcodec_flush_buffers(decoder->codecCtx);
+            decoder->pcmBuffer.discard();
+            decoder->audioSerial = serial;
+            decoder->discardTarget = decoder->seekTarget.loadAcquire();
+            qDebug() << "seek audio";
         }
 
-        SDL_AudioBufSize -= left;
-        stream += left;
-        decoder->audioBufIndex += left;
+        TRACE_BEGIN("audio_decode_packet");
+        ret = avcodec_send_packet(decoder->codecCtx, &packet);
+        av_packet_unref(&packet);
+        // 每次送入后都会把解码器中的帧全部取出，所以这里不会出现 EAGAIN
+        if ((ret < 0) && (ret != AVERROR_EOF)) {
+            qDebug() << "Audio send to decoder failed, error code: " << ret;
+            TRACE_END("audio_decode_packet");
+            continue;
+        }
+
+        decoder->receiveFrames(frame, serial);
+        TRACE_END("audio_decode_packet");
     }
+
+    av_frame_free(&frame);
+
+    qDebug() << "Audio decoder finished.";
+
+    return 0;
 }
 
-int AudioDecoder::decodeAudio()
+/**
+ * @brief 等待 PCM 缓冲区中的数据全部播放完
+ * @return true 已播放完；false 停止或发生跳转
+ */
+bool AudioDecoder::waitForDrain()
 {
-    int ret;
-    AVFrame *frame = av_frame_alloc();
-    int resampledDataSize;
+    int serial = packetQueue.serial();
 
-    if (!frame) {
-        qDebug() << "Decode audio frame alloc failed.";
-        return -1;
+    while (pcmBuffer.available() > 0) {
+        if (isStop || serial != packetQueue.serial()) {
+            return false;
+        }
+        // 音频回调每取走一段数据唤醒一次，停止或跳转时也会唤醒
+        pcmBuffer.waitForSpace(pcmBuffer.size());
     }
 
-    if (isStop) {
-        return -1;
-    }
+    // 硬件缓冲区中还有最后一段数据
+    SDL_Delay(spec.samples * 1000 / spec.freq);
 
-    if (packetQueue.queueSize() <= 0) {
-        if (isreadFinished) {
-            // 队列中没有帧且文件已读取完则停止
-            isStop = true;
-            SDL_Delay(100);
-            // 通知解码器音频已播放完
-            emit playFinished();
-        }
-        // 没有数据直接返回
-        return -1;
-    }
+    // 跳转会恢复包队列，回到解码循环继续取包
+    return !isStop && serial == packetQueue.serial();
+}
 
-    /* get new packet whiel last packet all has been resolved */
-    if (sendReturn != AVERROR(EAGAIN)) {
-        // 如果解码缓冲区没有满则取出一个packet
-        packetQueue.dequeue(&packet, true);
-    }
+// 取出解码器中所有已就绪的帧，重采样后写入 PCM 缓冲区，跳转或停止时不再继续
+void AudioDecoder::receiveFrames(AVFrame *frame, int serial)
+{
+    int ret;
 
-    if (packet.size == 5 && memcmp(packet.data, "FLUSH", 5) == 0) {
-        // 清空缓冲区
-        avcodec_flush_buffers(codecCtx);
-        av_packet_unref(&packet);
-        av_frame_free(&frame);
-        sendReturn = 0;
-        qDebug() << "seek audio";
-        return -1;
-    }
+    while (!isStop && serial == packetQueue.serial()) {
+        ret = avcodec_receive_frame(codecCtx, frame);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            break;
+        } else if (ret < 0) {
+            qDebug() << "Audio frame decode failed, error code: " << ret;
+            break;
+        }
 
-    /* while return -11 means packet have data not resolved,
-     * this packet cannot be unref
-     */
-    sendReturn = avcodec_send_packet(codecCtx, &packet);
-    if ((sendReturn < 0) && (sendReturn != AVERROR(EAGAIN)) && (sendReturn != AVERROR_EOF)) {
-        av_packet_unref(&packet);
-        av_frame_free(&frame);
-        qDebug() << "Audio send to decoder failed, error code: " << sendReturn;
-        return sendReturn;
+        resampleFrame(frame, serial);
+        av_frame_unref(frame);
     }
+}
 
-    ret = avcodec_receive_frame(codecCtx, frame);
-    if ((ret < 0) && (ret != AVERROR(EAGAIN))) {
-        av_packet_unref(&packet);
-        av_frame_free(&frame);
-        qDebug() << "Audio frame decode failed, error code: " << ret;
-        return ret;
-    }
+// 重采样一帧并写入 PCM 缓冲区
+void AudioDecoder::resampleFrame(AVFrame *frame, int serial)
+{
+    const quint8 *audioBuf;
+    int resampledDataSize;
+    double framePts = -1;
 
     if (frame->pts != AV_NOPTS_VALUE) {
         // 如果时间戳有效
         // 转为秒数
-        clock = av_q2d(stream->time_base) * frame->pts;
-//        qDebug() << "no pts";
+        framePts = av_q2d(stream->time_base) * frame->pts;
+    }
+
+    // 精确跳转：整帧都在目标之前的直接丢弃，不做重采样；没有时间戳时无法判断，不再丢弃
+    if (discardTarget != AV_NOPTS_VALUE) {
+        if (framePts < 0) {
+            discardTarget = AV_NOPTS_VALUE;
+        } else if ((framePts + static_cast<double>(frame->nb_samples) / frame->sample_rate) * AV_TIME_BASE <= discardTarget) {
+            return;
+        }
     }
 
     /* get audio channels */
@@ -416,9 +666,8 @@ int AudioDecoder::decodeAudio()
                 inChannelLayout, (AVSampleFormat)frame->format , frame->sample_rate, 0, NULL);
         // 启动重采样，激活配置
         if (!aCovertCtx || (swr_init(aCovertCtx) < 0)) {
-            av_packet_unref(&packet);
-            av_frame_free(&frame);
-            return -1;
+            swr_free(&aCovertCtx);
+            return;
         }
 
         // 保存当前参数
@@ -428,49 +677,69 @@ int AudioDecoder::decodeAudio()
         audioSrcChannels        = frame->channels;
     }
 
-    if (aCovertCtx) {
-        // 解码器输出的原始数据
-        const quint8 **in   = (const quint8 **)frame->extended_data;
-        // 目标缓冲区
-        uint8_t *out[] = {audioBuf1};
-        // 目标缓冲区能容纳的最大样本数
-        int outCount = sizeof(audioBuf1) / spec.channels / av_get_bytes_per_sample(audioDstFmt);
-        // 重采样执行（实际转换出来的每声道样本数。）
-        int sampleSize = swr_convert(aCovertCtx, out, outCount, in, frame->nb_samples);
-        if (sampleSize < 0) {
-            ///qDebug() << "swr convert failed";
-            av_packet_unref(&packet);
-            av_frame_free(&frame);
-            return -1;
-        }
+    // 解码器输出的原始数据
+    const quint8 **in   = (const quint8 **)frame->extended_data;
+    // 目标缓冲区
+    uint8_t *out[] = {audioBuf1};
+    // 目标缓冲区能容纳的最大样本数
+    int outCount = sizeof(audioBuf1) / spec.channels / av_get_bytes_per_sample(audioDstFmt);
+    // 重采样执行（实际转换出来的每声道样本数。）
+    int sampleSize = swr_convert(aCovertCtx, out, outCount, in, frame->nb_samples);
+    if (sampleSize < 0) {
+        qDebug() << "swr convert failed";
+        return;
+    }
 
-        if (sampleSize == outCount) {
-            // 可能还有剩余的数据留在 SwrContext 内部没吐出来
-            qDebug() << "audio buffer is probably too small";
-            // 尝试重新 swr_init。虽然这能清空内部缓存，但可能会导致极短的音频丢失（跳音）
-            if (swr_init(aCovertCtx) < 0) {
-                swr_free(&aCovertCtx);
-            }
+    if (sampleSize == outCount) {
+        // 可能还有剩余的数据留在 SwrContext 内部没吐出来
+        qDebug() << "audio buffer is probably too small";
+        // 尝试重新 swr_init。虽然这能清空内部缓存，但可能会导致极短的音频丢失（跳音）
+        if (swr_init(aCovertCtx) < 0) {
+            swr_free(&aCovertCtx);
         }
+    }
 
-        audioBuf = audioBuf1;
+    audioBuf = audioBuf1;
+    resampledDataSize = sampleSize * spec.channels * av_get_bytes_per_sample(audioDstFmt);
 
-        resampledDataSize = sampleSize * spec.channels * av_get_bytes_per_sample(audioDstFmt);
-    } else {
-        // 如果格式一致，直接让指针指向解码帧的数据，避免一次内存拷贝
-        audioBuf = frame->data[0];
-        // 当前帧数据的总字节数
-        resampledDataSize = av_samples_get_buffer_size(NULL, frame->channels, frame->nb_samples, static_cast<AVSampleFormat>(frame->format), 1);
+    // 跨过目标的一帧：去掉目标之前的采样，之后本序列不再丢弃
+    if (discardTarget != AV_NOPTS_VALUE) {
+        int frameBytes = spec.channels * av_get_bytes_per_sample(audioDstFmt);
+        int skipSamples = static_cast<int>((static_cast<double>(discardTarget) / AV_TIME_BASE - framePts) * spec.freq);
+        int skipBytes = FFMIN(FFMAX(skipSamples, 0) * frameBytes, resampledDataSize);
+
+        audioBuf            += skipBytes;
+        resampledDataSize   -= skipBytes;
+        discardTarget       = AV_NOPTS_VALUE;
     }
 
-    // 播放时钟更新
-    clock += static_cast<double>(resampledDataSize) / (audioDepth * codecCtx->channels * codecCtx->sample_rate);
+    // 缓冲区满时等待回调取走数据，跳转或停止时丢弃剩余部分
+    while (resampledDataSize > 0) {
+        if (isStop || serial != packetQueue.serial()) {
+            return;
+        }
 
-    if (sendReturn != AVERROR(EAGAIN)) {
-        av_packet_unref(&packet);
+        int written = pcmBuffer.write(audioBuf, resampledDataSize);
+        if (written == 0) {
+            if (isFreeRun) {
+                break;
+            }
+            // 等待音频回调取走数据，暂停期间一直等待，停止或跳转时被唤醒
+            TRACE_SCOPE("pcm_wait_space");
+            pcmBuffer.waitForSpace(1);
+            continue;
+        }
+
+        audioBuf += written;
+        resampledDataSize -= written;
     }
 
-    av_frame_free(&frame);
+    // 播放时钟更新：指向已写入数据的末尾
+    if (framePts >= 0) {
+        writeClock = framePts + static_cast<double>(frame->nb_samples) / frame->sample_rate;
+    } else {
+        writeClock += static_cast<double>(sampleSize) / spec.freq;
+    }
 
-    return resampledDataSize;
+    publishWritten(writeClock, serial);
 }
@@ -2,18 +2,27 @@
 #define AUDIODECODER_H
 
 #include <QObject>
+#include <QAtomicInt>
+#include <QAtomicInteger>
 
 extern "C"
 {
     #include "libswresample/swresample.h"
+    #include "libavutil/time.h"
 }
 
 #include "avpacketqueue.h"
+#include "audioringbuffer.h"
 
 class AudioDecoder : public QObject
 {
     Q_OBJECT
 public:
+    /* 输出监听（测试用）：音频回调把交给设备的数据、实际打开的设备参数和回调被调用的时刻
+     * （av_gettime_relative，微秒）原样传给监听函数，不经过音频时钟的延迟模型；在音频线程中调用，不能阻塞
+     */
+    typedef void (*OutputTap)(void *opaque, const SDL_AudioSpec *spec, const quint8 *data, int size, qint64 callbackTime);
+
     explicit AudioDecoder(QObject *parent = nullptr);
 
     int openAudio(AVFormatContext *pFormatCtx, int index);
@@ -23,33 +32,73 @@ public:
     int getVolume();
     void setVolume(int volume);
     double getAudioClock();
+    bool isClockRunning();
     void packetEnqueue(AVPacket *packet);
+    AvPacketQueue *getPacketQueue();
     void emptyAudioData();
     void setTotalTime(qint64 time);
     void setClock(double clk);
+    void setDeviceLatency(double latency);
+    void setFreeRun(bool freeRun);
+    void setSeekTarget(qint64 target);
+    void setOutputTap(OutputTap tap, void *opaque);
 
 private:
-    int decodeAudio();
+    static int decodeThread(void *arg);
+    void receiveFrames(AVFrame *frame, int serial);
+    void resampleFrame(AVFrame *frame, int serial);
+    bool waitForDrain();
+    void publishWritten(double endPts, int serial);
+    void updateClock(int size, qint64 callbackTime);
+    void publishClock(qint64 pts, qint64 time, qint64 maxPts, bool isFrozen);
     static void audioCallback(void *userdata, quint8 *stream, int SDL_AudioBufSize);
 
-    bool isStop;            // 停止标志位
-    bool isPause;           // 暂停标志位
-    bool isreadFinished;    // 文件读取完成标志位
+    QAtomicInt isStop;          // 停止标志位
+    QAtomicInt isPause;         // 暂停标志位
+    QAtomicInt isFreeRun;       // 全速运行：缓冲区满时丢弃数据，不等待设备播放
+
+    QAtomicInteger<qint64> seekTarget;  // 精确跳转的目标（微秒），AV_NOPTS_VALUE 表示不丢弃
 
     qint64 totalTime;       // 音频总时长
-    double clock;           // 音频原始时钟
     int volume;
 
+    /* 音频时钟（时间单位均为微秒）
+     * 每次音频回调记录（正在播放的 pts，回调时刻），读取时按单调时钟外推，不修改任何状态。
+     * 以序列锁发布：写入前后 clockSeq 各加一，读者看到奇数或前后不一致时重读，任意线程可无锁读取。
+     * 写者为音频回调，其它线程写入时持有 SDL_LockAudio()，保证同一时刻只有一个写者。
+     */
+    QAtomicInt clockSeq;
+    QAtomicInteger<qint64> clockPts;        // 回调时刻正在播放的 pts
+    QAtomicInteger<qint64> clockTime;       // 回调时刻（av_gettime_relative）
+    QAtomicInteger<qint64> clockMax;        // 已交给设备的数据末尾的 pts，外推不超过该值（欠载或播放结束时停住）
+    QAtomicInt clockFrozen;                 // 暂停时不外推
+    QAtomicInt clockPinned;                 // 时钟停在 setClock() 设置的位置，新序列的数据还没有开始播放
+
+    QAtomicInteger<qint64> deviceLatency;   // 额外的设备输出延迟（如蓝牙耳机），由使用者校准
+
+    OutputTap outputTap;            // 输出监听，由 SDL_LockAudio() 保护
+    void *outputTapOpaque;
+
+    /* 解码线程写入 PCM 缓冲区的进度，同样以序列锁发布给音频回调 */
+    QAtomicInt writeSeq;
+    QAtomicInteger<qint64> writeEndPts;     // 已写入数据末尾的 pts
+    QAtomicInteger<quint32> writeEndPos;    // 已写入数据末尾在缓冲区中的累计位置
+    QAtomicInt writeSerial;                 // 已写入数据所属的播放序列号
+    double writeClock;                      // 已写入数据末尾的 pts（秒，解码线程）
+
+    AudioRingBuffer pcmBuffer;      // 重采样后的 PCM 数据（解码线程 -> 音频回调）
+    quint8 *mixBuf;                 // 音频回调中调节音量用的暂存区，大小为 spec.size
+    int bytesPerSec;                // 每秒播放的字节数（采样率×通道数×位深）
+
+    SDL_Thread *decodeTid;          // 音频解码线程
+
     AVStream *stream;
 
-    quint8 *audioBuf;               // 音频暂存缓冲区
-    quint32 audioBufSize;           // 音频缓冲区大小
+    // 重采样输出缓冲区（解码线程）
     // DECLARE_ALIGNED(16, ...)：内存对齐   在内存中给 audioBuf1 分配空间时，其起始地址必须是 16 的倍数。
     // quint8, audioBuf1：数据类型与变量名
     // [192000]：缓冲区容量
     DECLARE_ALIGNED(16, quint8, audioBuf1) [192000];
-    quint32 audioBufSize1;
-    quint32 audioBufIndex;          // 目前播放到的位置
 
     SDL_AudioSpec spec;             // 音频硬件参数
 
@@ -68,16 +117,12 @@ private:
 
     AvPacketQueue packetQueue;
 
-    AVPacket packet;
-
-    int sendReturn;
+    int audioSerial;                // 解码器当前所处的播放序列号（解码线程）
+    qint64 discardTarget;           // 当前序列丢弃到的目标（微秒，解码线程）
 
 signals:
     void playFinished();
 
-public slots:
-    void readFileFinished();
-
 };
 
 #endif // AUDIODECODER_H
@@ -0,0 +1,190 @@
+﻿#include <string.h>
+
+#include "audioringbuffer.h"
+
+AudioRingBuffer::AudioRingBuffer() :
+    buffer(nullptr),
+    capacity(0),
+    mask(0),
+    readPos(0),
+    writePos(0),
+    isWriterWaiting(0)
+{
+    spaceSem = SDL_CreateSemaphore(0);
+}
+
+AudioRingBuffer::~AudioRingBuffer()
+{
+    release();
+    SDL_DestroySemaphore(spaceSem);
+}
+
+/**
+ * @brief 分配缓冲区，容量向上取整到 2 的幂
+ * @note  不是线程安全的，需在读写线程开始工作之前调用
+ */
+void AudioRingBuffer::allocate(int size)
+{
+    quint32 newCapacity = 2;
+    while (newCapacity < static_cast<quint32>(size)) {
+        newCapacity <<= 1;
+    }
+
+    if (newCapacity != capacity) {
+        release();
+        buffer      = new quint8[newCapacity];
+        capacity    = newCapacity;
+        mask        = newCapacity - 1;
+    }
+
+    readPos.storeRelease(0);
+    writePos.storeRelease(0);
+}
+
+// 释放缓冲区，需在读写线程都停止之后调用
+void AudioRingBuffer::release()
+{
+    delete[] buffer;
+    buffer      = nullptr;
+    capacity    = 0;
+    mask        = 0;
+}
+
+/**
+ * @brief 写入 PCM 数据（仅生产者线程调用），空间不足时只写入能容纳的部分
+ * @return 实际写入的字节数
+ */
+int AudioRingBuffer::write(const quint8 *data, int size)
+{
+    // 只有生产者修改 writePos，可以直接读取
+    quint32 w = writePos.load();
+    quint32 r = readPos.loadAcquire();
+
+    quint32 n = qMin(capacity - (w - r), static_cast<quint32>(size));
+    if (n == 0) {
+        return 0;
+    }
+
+    // 写入位置可能跨过缓冲区末尾，分两段拷贝
+    quint32 offset  = w & mask;
+    quint32 first   = qMin(n, capacity - offset);
+    memcpy(buffer + offset, data, first);
+    memcpy(buffer, data + first, n - first);
+
+    // 数据写完后再发布新的写位置
+    writePos.storeRelease(w + n);
+
+    return static_cast<int>(n);
+}
+
+/**
+ * @brief 读取 PCM 数据（仅消费者线程调用），不阻塞
+ * @return 实际读取的字节数；读取期间数据被 discard() 丢弃时返回 0
+ */
+int AudioRingBuffer::read(quint8 *data, int size)
+{
+    quint32 r = readPos.loadAcquire();
+    quint32 w = writePos.loadAcquire();
+
+    quint32 n = qMin(w - r, static_cast<quint32>(size));
+    if (n == 0) {
+        return 0;
+    }
+
+    quint32 offset  = r & mask;
+    quint32 first   = qMin(n, capacity - offset);
+    memcpy(data, buffer + offset, first);
+    memcpy(data + first, buffer, n - first);
+
+    /* 拷贝期间若被 discard()，这段空间可能已经写入了新数据，读到的内容作废
+     * 只有 CAS 成功才说明拷贝的是完整有效的数据
+     */
+    if (!readPos.testAndSetOrdered(r, r + n)) {
+        return 0;
+    }
+
+    // 写端在等待空间：只在它登记等待后唤醒一次，信号量的计数不会累积
+    if (isWriterWaiting.testAndSetOrdered(1, 0)) {
+        SDL_SemPost(spaceSem);
+    }
+
+    return static_cast<int>(n);
+}
+
+// 丢弃所有未读取的数据，可以在任意线程调用
+void AudioRingBuffer::discard()
+{
+    while (1) {
+        quint32 r = readPos.loadAcquire();
+        quint32 w = writePos.loadAcquire();
+
+        if (r == w || readPos.testAndSetOrdered(r, w)) {
+            break;
+        }
+    }
+
+    wakeWriter();
+}
+
+/**
+ * @brief 等待可写入的空间不少于 size 字节（仅生产者线程调用），size 为容量时即等待数据全部被读走
+ * @note  读端取走数据、discard() 或 wakeWriter() 时返回，返回后调用者需重新检查空间和停止、跳转状态。
+ *        暂停期间音频回调不再读取，写端一直等待，不会轮询
+ */
+void AudioRingBuffer::waitForSpace(int size)
+{
+    // 先登记等待再检查空间：读端先推进读位置再检查登记，两者至少有一方看到对方，不会漏掉唤醒
+    isWriterWaiting.fetchAndStoreOrdered(1);
+
+    if (freeSpace() >= size) {
+        // 读端可能已经取消登记并发出信号，多出的一次信号只会让下次等待提前返回重新检查
+        isWriterWaiting.testAndSetOrdered(1, 0);
+        return;
+    }
+
+    SDL_SemWait(spaceSem);
+}
+
+/**
+ * @brief 唤醒等待空间的写端，用于停止或跳转，可以在任意线程调用
+ * @note  不管写端是否已登记都发信号：写端可能刚检查完停止状态、还没开始等待，信号会留到它等待时
+ */
+void AudioRingBuffer::wakeWriter()
+{
+    isWriterWaiting.storeRelease(0);
+    SDL_SemPost(spaceSem);
+}
+
+// 可读取的字节数
+int AudioRingBuffer::available()
+{
+    // 先读 readPos 再读 writePos，writePos 只增不减，结果不会为负
+    quint32 r = readPos.loadAcquire();
+    quint32 w = writePos.loadAcquire();
+
+    return static_cast<int>(w - r);
+}
+
+// 可写入的字节数
+int AudioRingBuffer::freeSpace()
+{
+    return static_cast<int>(capacity) - available();
+}
+
+// 缓冲区容量（字节）
+int AudioRingBuffer::size()
+{
+    return static_cast<int>(capacity);
+}
+
+// 累计读取的字节数（单调递增，按 2^32 回绕），用于把读位置换算为时间戳
+quint32 AudioRingBuffer::readPosition()
+{
+    return readPos.loadAcquire();
+}
+
+// 累计写入的字节数（单调递增，按 2^32 回绕）
+quint32 AudioRingBuffer::writePosition()
+{
+    return writePos.loadAcquire();
+}
@@ -0,0 +1,62 @@
+#ifndef AUDIORINGBUFFER_H
+#define AUDIORINGBUFFER_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+
+#include "SDL2/SDL.h"
+
+/* 单生产者/单消费者无锁 PCM 环形缓冲区
+ * 音频解码线程写入重采样后的数据，SDL 音频回调读取，读写两端都不加锁。
+ * 写端没有空间时在信号量上等待，读端取走数据后发一次信号（sem_post 不会阻塞，可以在音频回调中调用）。
+ * discard() 可在任意线程调用（通过 CAS 与读端竞争读位置），用于 seek 时丢弃旧数据。
+ */
+class AudioRingBuffer
+{
+public:
+    AudioRingBuffer();
+    ~AudioRingBuffer();
+
+    void allocate(int size);
+
+    void release();
+
+    int write(const quint8 *data, int size);
+
+    int read(quint8 *data, int size);
+
+    void discard();
+
+    void waitForSpace(int size);
+
+    void wakeWriter();
+
+    int available();
+
+    int freeSpace();
+
+    int size();
+
+    quint32 readPosition();
+
+    quint32 writePosition();
+
+private:
+    // 读写位置之间用整条缓存行隔开，避免伪共享
+    enum { CacheLineSize = 64 };
+
+    quint8 *buffer;
+    quint32 capacity;       // 容量（字节），必须为 2 的幂
+    quint32 mask;
+
+    char padRead[CacheLineSize];
+    QAtomicInteger<quint32> readPos;    // 读位置（单调递增）
+    char padWrite[CacheLineSize - sizeof(QAtomicInteger<quint32>)];
+    QAtomicInteger<quint32> writePos;   // 写位置（单调递增）
+    char padEnd[CacheLineSize - sizeof(QAtomicInteger<quint32>)];
+
+    QAtomicInt isWriterWaiting;         // 写端正在等待空间，读端取走数据后唤醒
+    SDL_sem *spaceSem;
+};
+
+#endif // AUDIORINGBUFFER_H
@@ -1,29 +1,111 @@
 ﻿#include "avpacketqueue.h"
+#include "tracer.h"
 
-AvPacketQueue::AvPacketQueue()
+/* 另一个队列少于该包数时视为“饥饿”，此时不再因本队列已满而阻塞生产者，
+ * 避免交织不良的文件在视频队列满、音频队列空时互相等待造成死锁
+ */
+#define PACKET_QUEUE_MIN_PACKETS 16
+
+// 向上取整到 2 的幂，使槽位下标可以用位与代替取模
+static quint32 roundUpPowerOfTwo(int value)
 {
-    mutex   = SDL_CreateMutex();
-    cond    = SDL_CreateCond();
+    quint32 size = 2;
+    while (size < static_cast<quint32>(value)) {
+        size <<= 1;
+    }
+
+    return size;
 }
 
-// 原始帧入队
+AvPacketQueue::AvPacketQueue(int capacity) :
+    capacity(roundUpPowerOfTwo(capacity)),
+    mask(roundUpPowerOfTwo(capacity) - 1),
+    head(0),
+    tail(0),
+    totalBytes(0),
+    totalDuration(0),
+    currentSerial(0),
+    consumerWaiting(0),
+    producerWaiting(0),
+    maxBytes(0),
+    maxDuration(0),
+    timeBase(AVRational{1, AV_TIME_BASE}),
+    companion(nullptr),
+    isAbort(0),
+    isWakeup(0)
+{
+    ring = new PacketSlot[this->capacity];
+
+    mutex       = SDL_CreateMutex();
+    cond        = SDL_CreateCond();
+    spaceCond   = SDL_CreateCond();
+}
+
+AvPacketQueue::~AvPacketQueue()
+{
+    empty();
+
+    SDL_DestroyCond(spaceCond);
+    SDL_DestroyCond(cond);
+    SDL_DestroyMutex(mutex);
+
+    delete[] ring;
+}
+
+/**
+ * @brief 原始帧入队（仅生产者线程调用），包被标记为当前序列号
+ * @note  引用计数的包直接接管其引用，调用后 packet 被重置；
+ *        没有 buf 的包会复制一份数据，packet 保持不变。
+ *        环形缓冲区已满时阻塞，队列被 abort 时丢弃该包。
+ */
 void AvPacketQueue::enqueue(AVPacket *packet)
 {
-    AVPacket pktInQueue;
-    av_init_packet(&pktInQueue);
-    // 在锁外面先接管所有权，减少锁持有的时间
-    if (av_packet_ref(&pktInQueue, packet) < 0) {
-        // 如果 ref 失败（通常是因为 packet->buf 为空，比如你的常量字符串包）
-        // 那就手动拷贝一份数据
-        pktInQueue = *packet;
+    // 只有生产者修改 tail，可以直接读取
+    quint32 t = tail.load();
+
+    // 槽位用完：等待消费者取走数据（只有此时才进入休眠）
+    if (t - head.loadAcquire() >= capacity) {
+        TRACE_SCOPE("packet_queue_wait_space");
+        SDL_LockMutex(mutex);
+        // 先声明正在等待再检查条件，与消费者“先更新 head 再检查等待标志”配对，不会丢失唤醒
+        producerWaiting.fetchAndStoreOrdered(1);
+        while (t - head.loadAcquire() >= capacity && !isAbort.loadAcquire()) {
+            SDL_CondWait(spaceCond, mutex);
+        }
+        producerWaiting.fetchAndStoreOrdered(0);
+        SDL_UnlockMutex(mutex);
+
+        if (t - head.loadAcquire() >= capacity) {
+            // 被 abort 唤醒，队列仍然是满的
+            if (packet->buf) {
+                av_packet_unref(packet);
+            }
+            return;
+        }
     }
 
-    SDL_LockMutex(mutex);
+    PacketSlot *slot = &ring[t & mask];
+    if (packet->buf) {
+        // 直接转移引用，不增加引用计数也不拷贝数据
+        av_packet_move_ref(&slot->packet, packet);
+    } else {
+        // 槽位里残留的是上一次被取走的包的浅拷贝，先重置再复制数据
+        av_init_packet(&slot->packet);
+        if (av_packet_ref(&slot->packet, packet) < 0) {
+            return;
+        }
+    }
+    slot->serial = currentSerial.loadAcquire();
 
-    queue.enqueue(pktInQueue);
+    totalBytes.fetchAndAddOrdered(slot->packet.size);
+    totalDuration.fetchAndAddOrdered(av_rescale_q(slot->packet.duration, timeBase, av_get_time_base_q()));
 
-    SDL_CondSignal(cond);
-    SDL_UnlockMutex(mutex);
+    // 发布新数据，随后检查消费者是否在等待
+    tail.fetchAndStoreOrdered(t + 1);
+
+    if (consumerWaiting.loadAcquire()) {
+        notifyConsumer();
+    }
 }
 
 
@@ -31,58 +113,252 @@ void AvPacketQueue::enqueue(AVPacket *packet)
  * @brief 从队列中提取一个 AVPacket
  * * @param packet  用于存储提取出的数据包指针
  * @param isBlock 是否采用阻塞模式。true: 队列为空则等待；false: 立即返回
+ * @param serial  可选，返回该包入队时的序列号，与 serial() 不同说明是 seek 之前的旧包
+ * @return true 取到数据包；false 队列为空（非阻塞）或队列已被 abort
  */
-void AvPacketQueue::dequeue(AVPacket *packet, bool isBlock)
+bool AvPacketQueue::dequeue(AVPacket *packet, bool isBlock, int *serial)
 {
-    // 1. 进入临界区：锁定互斥锁，确保多线程下对 queue 操作的原子性
-    SDL_LockMutex(mutex);
+    // 快速路径：队列非空时不加锁
+    bool got = popPacket(packet, serial);
+
+    while (!got && isBlock && !isAbort.loadAcquire()) {
+        /* 队列为空，线程进入休眠等待
+         * 先置位 consumerWaiting 再检查队列，生产者发布数据后看到该标志才会加锁发信号，
+         * 两边都使用带完整内存屏障的原子操作，保证不会错过唤醒。
+         */
+        TRACE_SCOPE("packet_queue_wait_data");
+        SDL_LockMutex(mutex);
+        consumerWaiting.fetchAndStoreOrdered(1);
+        while (isEmpty() && !isAbort.loadAcquire()) {
+            SDL_CondWait(cond, mutex);
+        }
+        consumerWaiting.fetchAndStoreOrdered(0);
+        SDL_UnlockMutex(mutex);
+
+        // 唤醒后数据可能已被 empty() 清掉，取不到则继续等待
+        got = popPacket(packet, serial);
+    }
+
+    return got;
+}
+
+/**
+ * @brief 取出队头的包，消费者与 empty() 通过 CAS 竞争 head，谁成功谁拥有该包
+ * @note  槽位内容只在 head 越过它之后才会被生产者覆盖，CAS 失败时丢弃读到的副本即可
+ */
+bool AvPacketQueue::popPacket(AVPacket *packet, int *serial)
+{
+    PacketSlot slot;
 
     while (1) {
-        // 2. 检查队列是否有数据
-        if (!queue.isEmpty()) {
-            // 成功获取：从 Qt 队列中弹出头部数据包并赋值
-            *packet = queue.dequeue();
-            break;
+        quint32 h = head.loadAcquire();
+        if (h == tail.loadAcquire()) {
+            return false;
         }
-        // 3. 队列为空时的处理逻辑
-        else if (!isBlock) {
-            // 非阻塞模式：如果不允许等待，直接跳出循环
+
+        slot = ring[h & mask];
+        if (head.testAndSetOrdered(h, h + 1)) {
             break;
         }
-        else {
-            /* * 4. 阻塞模式：队列为空，线程进入休眠等待
-             * SDL_CondWait 会执行以下原子操作：
-             * a) 释放互斥锁 mutex，允许“生产者”线程进入并添加数据。
-             * b) 线程进入休眠，等待 cond 信号唤醒。
-             * c) 被唤醒后，重新抢占锁 mutex，然后继续下一次 while 循环检查。
-             */
-            SDL_CondWait(cond, mutex);
-        }
     }
 
-    // 5. 退出临界区：释放互斥锁，允许其他线程访问
-    SDL_UnlockMutex(mutex);
+    *packet = slot.packet;
+    if (serial) {
+        *serial = slot.serial;
+    }
+
+    totalBytes.fetchAndAddOrdered(-slot.packet.size);
+    totalDuration.fetchAndAddOrdered(-av_rescale_q(slot.packet.duration, timeBase, av_get_time_base_q()));
+
+    // 取走数据后队列有了空间，通知等待的生产者
+    notifySpace();
+
+    // 本队列快被取空时，生产者可能正阻塞在另一个已满的队列上，需要唤醒它继续读取
+    if (companion && queueSize() < PACKET_QUEUE_MIN_PACKETS) {
+        companion->notifySpace();
+    }
+
+    return true;
 }
 
 
-// 清空队列
+// 清空队列，可以在任意线程调用
 void AvPacketQueue::empty()
 {
-    SDL_LockMutex(mutex);
-    while (queue.size() > 0) {
-        AVPacket packet = queue.dequeue();
+    AVPacket packet;
+
+    while (popPacket(&packet, nullptr)) {
         av_packet_unref(&packet);
     }
+}
 
-    SDL_UnlockMutex(mutex);
+// 当前播放序列号，消费者可随时无锁读取
+int AvPacketQueue::serial()
+{
+    return currentSerial.loadAcquire();
+}
+
+/**
+ * @brief 开始新的播放序列（seek 时由生产者调用）
+ * @note  先增加序列号再清空，消费者手中或队列中残留的旧包都会因序列号不符被丢弃
+ */
+void AvPacketQueue::flush()
+{
+    currentSerial.fetchAndAddOrdered(1);
+
+    empty();
 }
 
 bool AvPacketQueue::isEmpty()
 {
-    return queue.isEmpty();
+    return queueSize() == 0;
 }
 
 int AvPacketQueue::queueSize()
 {
-    return queue.size();
+    // 先读 head 再读 tail，tail 只增不减，结果不会为负
+    quint32 h = head.loadAcquire();
+    quint32 t = tail.loadAcquire();
+
+    return static_cast<int>(t - h);
+}
+
+// 队列中数据包的总字节数
+qint64 AvPacketQueue::queueBytes()
+{
+    return totalBytes.loadAcquire();
+}
+
+// 队列中数据包的总时长（微秒）
+qint64 AvPacketQueue::queueDuration()
+{
+    return totalDuration.loadAcquire();
+}
+
+// 设置包时长的时间基，需在入队前设置（通常为所属流的 time_base）
+void AvPacketQueue::setTimeBase(AVRational timeBase)
+{
+    this->timeBase = timeBase;
+}
+
+/**
+ * @brief 设置队列容量上限，任意一项超出即视为已满
+ * @param maxBytes    字节上限，<= 0 表示不限制
+ * @param maxDuration 时长上限（微秒），<= 0 表示不限制
+ * @note  需在开始入队前设置
+ */
+void AvPacketQueue::setLimits(qint64 maxBytes, qint64 maxDuration)
+{
+    this->maxBytes      = maxBytes;
+    this->maxDuration   = maxDuration;
+}
+
+// 关联同一生产者写入的另一个队列，传入 nullptr 取消关联，需在开始入队前设置
+void AvPacketQueue::setCompanion(AvPacketQueue *queue)
+{
+    companion = queue;
+}
+
+bool AvPacketQueue::isFull()
+{
+    if (static_cast<quint32>(queueSize()) >= capacity) {
+        return true;
+    }
+
+    if (maxBytes > 0 && totalBytes.loadAcquire() >= maxBytes) {
+        return true;
+    }
+
+    // 时长以包自带的 duration 累计，部分封装格式不提供 duration 时只受字节数限制
+    if (maxDuration > 0 && totalDuration.loadAcquire() >= maxDuration) {
+        return true;
+    }
+
+    return false;
+}
+
+// 关联队列快被取空，说明消费者在等待数据，此时不应再阻塞生产者
+bool AvPacketQueue::isStarving()
+{
+    return companion && companion->queueSize() < PACKET_QUEUE_MIN_PACKETS;
+}
+
+/**
+ * @brief 生产者在读取下一个数据包前调用，队列已满时阻塞直到有空间
+ * @return true 队列有空间；false 被 wakeup()/abort() 打断，调用者应重新检查停止/跳转标志
+ */
+bool AvPacketQueue::waitForSpace()
+{
+    bool ret = true;
+
+    if (!isFull() || isStarving()) {
+        isWakeup.storeRelease(0);
+        return true;
+    }
+
+    TRACE_SCOPE("packet_queue_wait_space");
+    SDL_LockMutex(mutex);
+    producerWaiting.fetchAndStoreOrdered(1);
+
+    while (isFull() && !isStarving()) {
+        if (isAbort.loadAcquire() || isWakeup.loadAcquire()) {
+            ret = false;
+            break;
+        }
+
+        SDL_CondWait(spaceCond, mutex);
+    }
+
+    producerWaiting.fetchAndStoreOrdered(0);
+    isWakeup.storeRelease(0);
+
+    SDL_UnlockMutex(mutex);
+
+    return ret;
+}
+
+// 唤醒阻塞在 waitForSpace() 上的生产者一次（如 seek 请求到来时）
+void AvPacketQueue::wakeup()
+{
+    isWakeup.fetchAndStoreOrdered(1);
+
+    SDL_LockMutex(mutex);
+    SDL_CondBroadcast(spaceCond);
+    SDL_UnlockMutex(mutex);
+}
+
+// 停止队列：唤醒所有等待的生产者和消费者，之后不再阻塞，直到 resume()
+void AvPacketQueue::abort()
+{
+    isAbort.fetchAndStoreOrdered(1);
+
+    SDL_LockMutex(mutex);
+    SDL_CondBroadcast(spaceCond);
+    SDL_CondBroadcast(cond);
+    SDL_UnlockMutex(mutex);
+}
+
+// 恢复队列的阻塞行为，开始播放新文件前调用
+void AvPacketQueue::resume()
+{
+    isAbort.fetchAndStoreOrdered(0);
+    isWakeup.fetchAndStoreOrdered(0);
+}
+
+// 生产者发布了新数据，唤醒等待的消费者
+void AvPacketQueue::notifyConsumer()
+{
+    SDL_LockMutex(mutex);
+    SDL_CondSignal(cond);
+    SDL_UnlockMutex(mutex);
+}
+
+// 队列有了空间，生产者在等待时才加锁唤醒它重新检查
+void AvPacketQueue::notifySpace()
+{
+    if (producerWaiting.loadAcquire()) {
+        SDL_LockMutex(mutex);
+        SDL_CondBroadcast(spaceCond);
+        SDL_UnlockMutex(mutex);
+    }
 }
@@ -1,7 +1,8 @@
 #ifndef AVPACKETQUEUE_H
 #define AVPACKETQUEUE_H
 
-#include <QQueue>
+#include <QAtomicInt>
+#include <QAtomicInteger>
 
 extern "C"
 {
@@ -11,14 +12,27 @@ extern "C"
 
 #include "SDL2/SDL.h"
 
+/* 单生产者/单消费者（SPSC）无锁环形队列
+ * 每个队列只有一个生产者（解复用线程）和一个消费者（视频解码线程或音频解码线程），
+ * 入队/出队只操作原子的 head/tail，只有在队列空或满时才通过 SDL_cond 休眠。
+ * empty() 可在任意线程调用（通过 CAS 与消费者竞争 head）。
+ *
+ * 每个包入队时记录队列当前的序列号（serial），flush() 使序列号加一，
+ * 消费者据此丢弃 seek 之前的旧包/旧帧，并在序列号变化时只清空一次解码器。
+ */
 class AvPacketQueue
 {
 public:
-    explicit AvPacketQueue();
+    explicit AvPacketQueue(int capacity = 4096);
+    ~AvPacketQueue();
 
     void enqueue(AVPacket *packet);
 
-    void dequeue(AVPacket *packet, bool isBlock);
+    bool dequeue(AVPacket *packet, bool isBlock, int *serial = nullptr);
+
+    int serial();
+
+    void flush();
 
     bool isEmpty();
 
@@ -26,11 +40,72 @@ public:
 
     int queueSize();
 
+    qint64 queueBytes();
+
+    qint64 queueDuration();
+
+    void setTimeBase(AVRational timeBase);
+
+    void setLimits(qint64 maxBytes, qint64 maxDuration);
+
+    void setCompanion(AvPacketQueue *queue);
+
+    bool isFull();
+
+    bool waitForSpace();
+
+    void wakeup();
+
+    void abort();
+
+    void resume();
+
 private:
-    SDL_mutex *mutex;
-    SDL_cond *cond;
+    bool isStarving();
+    bool popPacket(AVPacket *packet, int *serial);
+    void notifyConsumer();
+    void notifySpace();
 
-    QQueue<AVPacket> queue;
+    // head/tail 之间用整条缓存行隔开，避免生产者与消费者互相使对方的缓存行失效（伪共享）
+    enum { CacheLineSize = 64 };
+
+    struct PacketSlot {
+        AVPacket packet;
+        int serial;             // 入队时的播放序列号
+    };
+
+    PacketSlot *ring;           // 预分配的包槽位
+    const quint32 capacity;     // 槽位数，必须为 2 的幂
+    const quint32 mask;
+
+    char padHead[CacheLineSize];
+    QAtomicInteger<quint32> head;   // 消费者读位置（单调递增）
+    char padTail[CacheLineSize - sizeof(QAtomicInteger<quint32>)];
+    QAtomicInteger<quint32> tail;   // 生产者写位置（单调递增）
+    char padTotal[CacheLineSize - sizeof(QAtomicInteger<quint32>)];
+
+    QAtomicInteger<qint64> totalBytes;      // 队列中所有包的字节数
+    QAtomicInteger<qint64> totalDuration;   // 队列中所有包的时长（微秒）
+
+    QAtomicInt currentSerial;       // 当前播放序列号，每次 flush() 加一
+
+    QAtomicInt consumerWaiting;     // 消费者正在等待数据
+    QAtomicInt producerWaiting;     // 生产者正在等待空间
+
+    qint64 maxBytes;        // 字节上限，<= 0 表示不限制
+    qint64 maxDuration;     // 时长上限（微秒），<= 0 表示不限制
+
+    AVRational timeBase;    // 包时长所用的时间基（所属流的 time_base）
+
+    AvPacketQueue *companion;   // 同一解复用线程写入的另一个队列
+
+    QAtomicInt isAbort;     // 停止时唤醒所有等待者，不再阻塞
+    QAtomicInt isWakeup;    // 一次性唤醒生产者（seek 时使用）
+
+    // 仅在队列空/满需要休眠时使用
+    SDL_mutex *mutex;
+    SDL_cond *cond;         // 队列非空条件（消费者等待）
+    SDL_cond *spaceCond;    // 队列有空间条件（生产者等待）
 };
 
 #endif // AVPACKETQUEUE_H
@@ -0,0 +1,125 @@
+﻿#include <QElapsedTimer>
+#include <QDebug>
+
+extern "C"
+{
+#include "libswresample/swresample.h"
+#include "libavutil/time.h"
+}
+
+#include "audiobench.h"
+#include "lavfisource.h"
+#include "audioringbuffer.h"
+
+/* 输出格式与 AudioDecoder 打开的 SDL 设备一致：32 位浮点、双声道 */
+#define AUDIO_OUT_RATE      48000
+#define AUDIO_OUT_CHANNELS  2
+
+/**
+ * @brief 解码 lavfi 生成的 44.1 kHz 16 位立体声正弦波，重采样为 48 kHz 浮点后写入 PCM 环形缓冲区并立即读出
+ * @param seconds 生成的音频时长
+ * @note  44.1 kHz -> 48 kHz 需要真正的重采样，与 CD 音源在常见声卡上播放的情况一致
+ */
+QJsonObject runAudioBench(int seconds)
+{
+    QJsonObject result;
+    LavfiSource source;
+    AVPacket packet;
+    AVFrame *frame;
+    SwrContext *swrCtx;
+    AudioRingBuffer ring;
+    QElapsedTimer timer;
+    qint64 decodeTime = 0, resampleTime = 0, bufferTime = 0;
+    qint64 inSamples = 0, outSamples = 0;
+
+    QString graph = QString("sine=frequency=1000:sample_rate=44100:duration=%1,"
+                            "aformat=sample_fmts=s16:channel_layouts=stereo").arg(seconds);
+    if (!openLavfiSource(&source, graph)) {
+        return result;
+    }
+
+    swrCtx = swr_alloc_set_opts(nullptr, av_get_default_channel_layout(AUDIO_OUT_CHANNELS), AV_SAMPLE_FMT_FLT, AUDIO_OUT_RATE,
+                                av_get_default_channel_layout(source.codecCtx->channels), source.codecCtx->sample_fmt,
+                                source.codecCtx->sample_rate, 0, NULL);
+    if (!swrCtx || swr_init(swrCtx) < 0) {
+        qDebug() << "swr init failed";
+        swr_free(&swrCtx);
+        closeLavfiSource(&source);
+        return result;
+    }
+
+    // 与 AudioDecoder 相同的缓冲区大小：重采样输出 192000 字节，PCM 环形缓冲区 0.5 秒
+    QByteArray outBuf(192000, 0);
+    QByteArray readBuf(192000, 0);
+    int bytesPerSample = AUDIO_OUT_CHANNELS * av_get_bytes_per_sample(AV_SAMPLE_FMT_FLT);
+    ring.allocate(AUDIO_OUT_RATE * bytesPerSample / 2);
+
+    frame = av_frame_alloc();
+    timer.start();
+
+    while (av_read_frame(source.formatCtx, &packet) >= 0) {
+        qint64 start = av_gettime_relative();
+        avcodec_send_packet(source.codecCtx, &packet);
+        av_packet_unref(&packet);
+
+        while (true) {
+            int ret = avcodec_receive_frame(source.codecCtx, frame);
+            qint64 decoded = av_gettime_relative();
+            decodeTime += decoded - start;
+            if (ret < 0) {
+                break;
+            }
+
+            uint8_t *out[] = {reinterpret_cast<uint8_t *>(outBuf.data())};
+            int outCount = outBuf.size() / bytesPerSample;
+            int samples = swr_convert(swrCtx, out, outCount, (const uint8_t **)frame->extended_data, frame->nb_samples);
+            qint64 resampled = av_gettime_relative();
+            resampleTime += resampled - decoded;
+
+            inSamples += frame->nb_samples;
+            av_frame_unref(frame);
+
+            if (samples > 0) {
+                outSamples += samples;
+
+                // 解码线程写入、音频回调读出，这里在同一线程中依次完成
+                const quint8 *data = reinterpret_cast<const quint8 *>(outBuf.constData());
+                int size = samples * bytesPerSample;
+                while (size > 0) {
+                    int written = ring.write(data, size);
+                    ring.read(reinterpret_cast<quint8 *>(readBuf.data()), written);
+                    data += written;
+                    size -= written;
+                }
+            }
+            bufferTime += av_gettime_relative() - resampled;
+
+            start = av_gettime_relative();
+        }
+    }
+
+    qint64 elapsed = timer.nsecsElapsed();
+    double audioSeconds = static_cast<double>(inSamples) / source.codecCtx->sample_rate;
+
+    result["bench"]             = "audio_decode_resample";
+    result["in_rate"]           = source.codecCtx->sample_rate;
+    result["in_format"]         = av_get_sample_fmt_name(source.codecCtx->sample_fmt);
+    result["out_rate"]          = AUDIO_OUT_RATE;
+    result["in_samples"]        = inSamples;
+    result["out_samples"]       = outSamples;
+    result["elapsed_ms"]        = elapsed / 1e6;
+    result["decode_ms"]         = decodeTime / 1e3;
+    result["resample_ms"]       = resampleTime / 1e3;
+    result["buffer_ms"]         = bufferTime / 1e3;
+    result["ns_per_sample"]     = inSamples > 0 ? (decodeTime + resampleTime + bufferTime) * 1e3 / inSamples : 0;
+    // 处理速度相对实时播放的倍数（不含 lavfi 生成测试信号的时间）
+    result["realtime_factor"]   = decodeTime + resampleTime + bufferTime > 0 ?
+                                  audioSeconds * 1e6 / (decodeTime + resampleTime + bufferTime) : 0;
+
+    av_frame_free(&frame);
+    swr_free(&swrCtx);
+    ring.release();
+    closeLavfiSource(&source);
+
+    return result;
+}
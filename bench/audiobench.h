@@ -0,0 +1,9 @@
+#ifndef AUDIOBENCH_H
+#define AUDIOBENCH_H
+
+#include <QJsonObject>
+
+// 音频解码 + 重采样 + PCM 缓冲区吞吐量测试：与 AudioDecoder 解码线程的处理步骤相同，输入由 lavfi sine 生成
+QJsonObject runAudioBench(int seconds);
+
+#endif // AUDIOBENCH_H
@@ -0,0 +1,60 @@
+#-------------------------------------------------
+#
+# FFmpegQtPlayer 组件性能测试，独立于播放器主程序构建
+#
+#-------------------------------------------------
+
+# QImage 交接测试需要 gui 模块，不创建窗口
+QT       += core gui
+
+TARGET = FFmpegQtPlayerBench
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+        main.cpp \
+    queuebench.cpp \
+    decodebench.cpp \
+    audiobench.cpp \
+    filterbench.cpp \
+    lavfisource.cpp \
+    ../avpacketqueue.cpp \
+    ../audioringbuffer.cpp \
+    ../videofilter.cpp
+
+HEADERS += \
+    queuebench.h \
+    decodebench.h \
+    audiobench.h \
+    filterbench.h \
+    lavfisource.h \
+    ../avpacketqueue.h \
+    ../audioringbuffer.h \
+    ../videofilter.h
+
+INCLUDEPATH += $$PWD/..
+
+# Windows 使用随工程附带的 FFmpeg / SDL；Linux（无界面测试机）使用系统安装的库
+win32 {
+    INCLUDEPATH += $$PWD/../ffmpeg/include \
+                    $$PWD/../sdl/include
+
+    LIBS    += $$PWD/../ffmpeg/lib/avcodec.lib \
+                $$PWD/../ffmpeg/lib/avdevice.lib \
+                $$PWD/../ffmpeg/lib/avfilter.lib \
+                $$PWD/../ffmpeg/lib/avformat.lib \
+                $$PWD/../ffmpeg/lib/avutil.lib \
+                $$PWD/../ffmpeg/lib/postproc.lib \
+                $$PWD/../ffmpeg/lib/swresample.lib \
+                $$PWD/../ffmpeg/lib/swscale.lib \
+                $$PWD/../sdl/lib/libSDL2.a
+}
+
+unix {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libavcodec libavdevice libavfilter libavformat libavutil libswresample libswscale sdl2
+}
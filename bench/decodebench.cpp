@@ -0,0 +1,132 @@
+﻿#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QThread>
+#include <QDebug>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+}
+
+#include "decodebench.h"
+
+/**
+ * @brief 用指定线程配置解码文件中的视频流（不做滤镜和显示），统计解码帧率
+ * @return 测试结果，打开失败时返回空对象
+ */
+static QJsonObject benchDecode(const QString &file, int maxFrames, int threadCount, int threadType)
+{
+    QJsonObject result;
+    AVFormatContext *formatCtx = NULL;
+    AVCodecContext *codecCtx = NULL;
+    AVCodec *codec = NULL;
+    AVPacket packet;
+    AVFrame *frame;
+    int videoIndex;
+    int frames = 0;
+    QElapsedTimer timer;
+
+    if (avformat_open_input(&formatCtx, file.toLocal8Bit().data(), NULL, NULL) != 0) {
+        qDebug() << "Open file failed.";
+        return result;
+    }
+
+    if (avformat_find_stream_info(formatCtx, NULL) < 0
+            || (videoIndex = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0)) < 0) {
+        qDebug() << "Could't find video stream.";
+        avformat_close_input(&formatCtx);
+        return result;
+    }
+
+    codecCtx = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(codecCtx, formatCtx->streams[videoIndex]->codecpar);
+    codecCtx->thread_count  = threadCount;
+    codecCtx->thread_type   = threadType;
+
+    if (avcodec_open2(codecCtx, codec, NULL) < 0) {
+        qDebug() << "Could not open video decoder.";
+        avcodec_free_context(&codecCtx);
+        avformat_close_input(&formatCtx);
+        return result;
+    }
+
+    frame = av_frame_alloc();
+    timer.start();
+
+    // 读包和解码都计入时间，与播放器解复用 + 解码的实际负载一致
+    while (frames < maxFrames && av_read_frame(formatCtx, &packet) >= 0) {
+        if (packet.stream_index == videoIndex) {
+            avcodec_send_packet(codecCtx, &packet);
+            while (avcodec_receive_frame(codecCtx, frame) >= 0) {
+                frames++;
+                av_frame_unref(frame);
+            }
+        }
+        av_packet_unref(&packet);
+    }
+
+    // 冲刷多线程解码延迟在解码器内部的帧
+    avcodec_send_packet(codecCtx, NULL);
+    while (avcodec_receive_frame(codecCtx, frame) >= 0) {
+        frames++;
+        av_frame_unref(frame);
+    }
+
+    qint64 elapsed = timer.nsecsElapsed();
+
+    result["bench"]         = "video_decode";
+    result["codec"]         = codec->name;
+    result["width"]         = codecCtx->width;
+    result["height"]        = codecCtx->height;
+    result["threads"]       = threadCount;
+    result["thread_type"]   = threadType == FF_THREAD_FRAME ? "frame" : (threadType == FF_THREAD_SLICE ? "slice" : "frame+slice");
+    result["active_thread_type"] = codecCtx->active_thread_type;
+    result["frames"]        = frames;
+    result["elapsed_ms"]    = elapsed / 1e6;
+    result["fps"]           = frames / (elapsed / 1e9);
+
+    av_frame_free(&frame);
+    avcodec_free_context(&codecCtx);
+    avformat_close_input(&formatCtx);
+
+    return result;
+}
+
+QJsonArray runDecodeBench(const QString &file, int maxFrames)
+{
+    QJsonArray results;
+    QList<int> threadCounts;
+    int cores = QThread::idealThreadCount();
+
+    // 1、2、4 ... 直到 CPU 核心数
+    for (int count = 1; count < cores; count *= 2) {
+        threadCounts << count;
+    }
+    threadCounts << cores;
+
+    const int threadTypes[] = {FF_THREAD_FRAME, FF_THREAD_SLICE};
+
+    for (int threadType : threadTypes) {
+        double baseFps = 0;
+
+        for (int count : threadCounts) {
+            QJsonObject result = benchDecode(file, maxFrames, count, threadType);
+            if (result.isEmpty()) {
+                return results;
+            }
+
+            // 相对单线程的加速比，以及平均到每个线程的帧率
+            double fps = result["fps"].toDouble();
+            if (count == 1) {
+                baseFps = fps;
+            }
+            result["speedup"]       = baseFps > 0 ? fps / baseFps : 0;
+            result["fps_per_thread"] = fps / count;
+
+            results.append(result);
+        }
+    }
+
+    return results;
+}
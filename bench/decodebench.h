@@ -0,0 +1,10 @@
+#ifndef DECODEBENCH_H
+#define DECODEBENCH_H
+
+#include <QJsonArray>
+#include <QString>
+
+// 视频解码吞吐量测试：按不同线程数和线程方式解码同一文件，输出 fps 随核心数的变化
+QJsonArray runDecodeBench(const QString &file, int maxFrames);
+
+#endif // DECODEBENCH_H
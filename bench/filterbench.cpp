@@ -0,0 +1,291 @@
+﻿#include <QElapsedTimer>
+#include <QImage>
+#include <QJsonObject>
+#include <QStringList>
+#include <QDebug>
+
+extern "C"
+{
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libswscale/swscale.h"
+#include "libavutil/pixdesc.h"
+}
+
+#include "filterbench.h"
+#include "lavfisource.h"
+#include "videofilter.h"
+
+/* 预先生成的不同画面数，测试时循环使用，避免占用过多内存 */
+#define FILTER_BENCH_SOURCE_FRAMES  30
+
+/**
+ * @brief 与 MainDecoder::convertFrame 相同的输出级：缩放到显示大小并转换为 RGB32，输入参数取自滤镜链的输出（没有滤镜链时取自源帧）
+ */
+static bool createOutputStage(VideoFilterGraph *output, const VideoFilterGraph &chain, const AVFrame *source,
+                              const QSize &displaySize)
+{
+    int width, height;
+    AVPixelFormat pixFmt;
+    AVRational timeBase, sar;
+
+    if (!chain.graph) {
+        width       = source->width;
+        height      = source->height;
+        pixFmt      = (AVPixelFormat)source->format;
+        timeBase    = AVRational{1, 30};
+        sar         = source->sample_aspect_ratio;
+    } else {
+        width       = av_buffersink_get_w(chain.sink);
+        height      = av_buffersink_get_h(chain.sink);
+        pixFmt      = (AVPixelFormat)av_buffersink_get_format(chain.sink);
+        timeBase    = av_buffersink_get_time_base(chain.sink);
+        sar         = av_buffersink_get_sample_aspect_ratio(chain.sink);
+    }
+
+    // 播放器默认不保持长宽比，拉伸填满窗口
+    QString desc = outputScaleFilter(width, height, sar, displaySize, false);
+
+    if (createVideoFilter(output, desc, width, height, pixFmt, timeBase, sar, true) < 0) {
+        qDebug() << "Filter bench: create output stage failed:" << desc;
+        return false;
+    }
+
+    return true;
+}
+
+// 一帧经过输出级，一帧进一帧出，处理后 frame 被 unref
+static bool convertFrame(VideoFilterGraph *output, AVFrame *frame)
+{
+    bool ok = av_buffersrc_add_frame(output->src, frame) >= 0 && av_buffersink_get_frame(output->sink, frame) >= 0;
+
+    av_frame_unref(frame);
+
+    return ok;
+}
+
+// 取出滤镜链的全部输出帧交给输出级，直到 EAGAIN / EOF，返回得到的帧数
+static int drainChain(VideoFilterGraph *chain, VideoFilterGraph *output, AVFrame *frame)
+{
+    int frames = 0;
+
+    while (av_buffersink_get_frame(chain->sink, frame) >= 0) {
+        if (convertFrame(output, frame)) {
+            frames++;
+        }
+    }
+
+    return frames;
+}
+
+// 滤镜链吞吐量：与 MainDecoder 一样整条滤镜链一个 graph，输出的每一帧再经过缩放到显示大小、转换为 RGB32 的输出级
+static QJsonObject benchFilterChain(const QString &chain, const QList<AVFrame *> &sources, int frameCount, const QSize &displaySize)
+{
+    QJsonObject result;
+    VideoFilterGraph chainGraph = {NULL, NULL, NULL};
+    VideoFilterGraph output = {NULL, NULL, NULL};
+    const AVFrame *first = sources.first();
+    QElapsedTimer timer;
+    AVFrame *frame;
+    int frames = 0;
+
+    timer.start();
+
+    if (!chain.isEmpty() && createVideoFilter(&chainGraph, chain, first->width, first->height, (AVPixelFormat)first->format,
+                                              AVRational{1, 30}, first->sample_aspect_ratio, false) < 0) {
+        qDebug() << "Filter bench: create filter chain failed:" << chain;
+        return result;
+    }
+
+    if (!createOutputStage(&output, chainGraph, first, displaySize)) {
+        freeVideoFilter(&chainGraph);
+        return result;
+    }
+
+    qint64 initTime = timer.nsecsElapsed();
+    timer.restart();
+
+    frame = av_frame_alloc();
+
+    for (int i = 0; i < frameCount; i++) {
+        av_frame_ref(frame, sources[i % sources.size()]);
+        frame->pts = i;
+
+        if (!chainGraph.graph) {
+            if (convertFrame(&output, frame)) {
+                frames++;
+            }
+        } else if (av_buffersrc_add_frame(chainGraph.src, frame) >= 0) {
+            frames += drainChain(&chainGraph, &output, frame);
+        } else {
+            av_frame_unref(frame);
+        }
+    }
+
+    // 冲刷滤镜链中缓存的帧
+    if (chainGraph.graph && av_buffersrc_add_frame(chainGraph.src, NULL) >= 0) {
+        frames += drainChain(&chainGraph, &output, frame);
+    }
+
+    qint64 elapsed = timer.nsecsElapsed();
+
+    result["bench"]         = "filter_chain";
+    result["filter"]        = chain.isEmpty() ? QString("bypass") : chain;
+    result["stages"]        = chainGraph.graph ? 2 : 1;
+    result["init_ms"]       = initTime / 1e6;
+    result["input_frames"]  = frameCount;
+    result["frames"]        = frames;
+    result["elapsed_ms"]    = elapsed / 1e6;
+    result["fps"]           = frames / (elapsed / 1e9);
+
+    freeVideoFilter(&chainGraph);
+    freeVideoFilter(&output);
+    av_frame_free(&frame);
+
+    return result;
+}
+
+// YUV -> RGB32 颜色空间转换（可同时缩放），单独测量 swscale 的开销
+static QJsonObject benchRgbConvert(const QList<AVFrame *> &sources, int frameCount, const QSize &displaySize)
+{
+    QJsonObject result;
+    const AVFrame *first = sources.first();
+    QElapsedTimer timer;
+
+    SwsContext *swsCtx = sws_getContext(first->width, first->height, (AVPixelFormat)first->format,
+                                        displaySize.width(), displaySize.height(), AV_PIX_FMT_RGB32,
+                                        SWS_BILINEAR, NULL, NULL, NULL);
+    if (!swsCtx) {
+        return result;
+    }
+
+    AVFrame *rgb = av_frame_alloc();
+    rgb->format = AV_PIX_FMT_RGB32;
+    rgb->width  = displaySize.width();
+    rgb->height = displaySize.height();
+    av_frame_get_buffer(rgb, 32);
+
+    timer.start();
+
+    for (int i = 0; i < frameCount; i++) {
+        const AVFrame *src = sources[i % sources.size()];
+        sws_scale(swsCtx, src->data, src->linesize, 0, src->height, rgb->data, rgb->linesize);
+    }
+
+    qint64 elapsed = timer.nsecsElapsed();
+
+    result["bench"]         = "rgb_convert";
+    result["src_format"]    = av_get_pix_fmt_name((AVPixelFormat)first->format);
+    result["src_size"]      = QString("%1x%2").arg(first->width).arg(first->height);
+    result["dst_size"]      = QString("%1x%2").arg(displaySize.width()).arg(displaySize.height());
+    result["frames"]        = frameCount;
+    result["elapsed_ms"]    = elapsed / 1e6;
+    result["fps"]           = frameCount / (elapsed / 1e9);
+
+    av_frame_free(&rgb);
+    sws_freeContext(swsCtx);
+
+    return result;
+}
+
+static void releaseFrame(void *info)
+{
+    AVFrame *frame = static_cast<AVFrame *>(info);
+    av_frame_free(&frame);
+}
+
+/**
+ * @brief RGB 帧交给界面的开销：零拷贝（QImage 引用帧，最后一个副本析构时释放）与深拷贝对比
+ * @note  模拟一次完整的交接：构造 QImage、传给界面（复制句柄）、界面释放
+ */
+static QJsonArray benchImageHandoff(int frameCount, const QSize &displaySize)
+{
+    QJsonArray results;
+    QElapsedTimer timer;
+
+    AVFrame *rgb = av_frame_alloc();
+    rgb->format = AV_PIX_FMT_RGB32;
+    rgb->width  = displaySize.width();
+    rgb->height = displaySize.height();
+    av_frame_get_buffer(rgb, 32);
+
+    const char *modes[] = {"zero_copy", "deep_copy"};
+
+    for (const char *mode : modes) {
+        bool isZeroCopy = qstrcmp(mode, "zero_copy") == 0;
+
+        timer.start();
+
+        for (int i = 0; i < frameCount; i++) {
+            QImage image;
+
+            if (isZeroCopy) {
+                AVFrame *ref = av_frame_clone(rgb);
+                image = QImage(static_cast<const uchar *>(ref->data[0]), ref->width, ref->height, ref->linesize[0],
+                               QImage::Format_ARGB32_Premultiplied, &releaseFrame, ref);
+            } else {
+                image = QImage(rgb->data[0], rgb->width, rgb->height, rgb->linesize[0], QImage::Format_RGB32).copy();
+            }
+
+            // 界面线程取走后丢弃
+            QImage taken = image;
+            image = QImage();
+        }
+
+        qint64 elapsed = timer.nsecsElapsed();
+
+        QJsonObject result;
+        result["bench"]         = "image_handoff";
+        result["mode"]          = mode;
+        result["size"]          = QString("%1x%2").arg(displaySize.width()).arg(displaySize.height());
+        result["frames"]        = frameCount;
+        result["elapsed_ms"]    = elapsed / 1e6;
+        result["ns_per_frame"]  = static_cast<double>(elapsed) / frameCount;
+        results.append(result);
+    }
+
+    av_frame_free(&rgb);
+
+    return results;
+}
+
+QJsonArray runFilterBench(int frameCount, const QSize &videoSize, const QSize &displaySize)
+{
+    QJsonArray results;
+
+    QString graph = QString("testsrc2=size=%1x%2:rate=30,format=yuv420p").arg(videoSize.width()).arg(videoSize.height());
+    QList<AVFrame *> sources = decodeLavfiFrames(graph, FILTER_BENCH_SOURCE_FRAMES);
+    if (sources.isEmpty()) {
+        return results;
+    }
+
+    // 旁路（只缩放转换）、播放器默认滤镜链、常用降噪
+    const QStringList chains = {"", "pp=hb/vb/dr/al", "hqdn3d"};
+    for (const QString &chain : chains) {
+        QJsonObject result = benchFilterChain(chain, sources, frameCount, displaySize);
+        if (!result.isEmpty()) {
+            results.append(result);
+        }
+    }
+
+    // 原始分辨率与显示大小两种转换
+    QJsonObject convert = benchRgbConvert(sources, frameCount, videoSize);
+    if (!convert.isEmpty()) {
+        results.append(convert);
+    }
+    if (displaySize != videoSize) {
+        convert = benchRgbConvert(sources, frameCount, displaySize);
+        if (!convert.isEmpty()) {
+            results.append(convert);
+        }
+    }
+
+    for (const QJsonValue &result : benchImageHandoff(frameCount, displaySize)) {
+        results.append(result);
+    }
+
+    freeFrames(&sources);
+
+    return results;
+}
@@ -0,0 +1,13 @@
+#ifndef FILTERBENCH_H
+#define FILTERBENCH_H
+
+#include <QJsonArray>
+#include <QSize>
+
+/* 视频显示路径测试，输入由 lavfi testsrc2 生成：
+ * 滤镜链（与 MainDecoder::initFilter 相同的分级结构）的创建耗时和吞吐量、
+ * YUV -> RGB32 转换、以及把 RGB 帧交给界面的 QImage 零拷贝 / 深拷贝对比
+ */
+QJsonArray runFilterBench(int frameCount, const QSize &videoSize, const QSize &displaySize);
+
+#endif // FILTERBENCH_H
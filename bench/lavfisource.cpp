@@ -0,0 +1,98 @@
+﻿#include <QDebug>
+
+extern "C"
+{
+#include "libavdevice/avdevice.h"
+}
+
+#include "lavfisource.h"
+
+/**
+ * @brief 打开 lavfi 滤镜图作为输入，并打开其唯一输出流的解码器（rawvideo / pcm）
+ * @param graph lavfi 滤镜图描述
+ */
+bool openLavfiSource(LavfiSource *source, const QString &graph)
+{
+    AVInputFormat *lavfi = av_find_input_format("lavfi");
+    AVCodec *codec;
+
+    source->formatCtx   = NULL;
+    source->codecCtx    = NULL;
+    source->stream      = NULL;
+
+    if (!lavfi) {
+        qDebug() << "lavfi input device not available.";
+        return false;
+    }
+
+    if (avformat_open_input(&source->formatCtx, graph.toLatin1().data(), lavfi, NULL) != 0) {
+        qDebug() << "Open lavfi source failed:" << graph;
+        return false;
+    }
+
+    if (avformat_find_stream_info(source->formatCtx, NULL) < 0 || source->formatCtx->nb_streams < 1) {
+        qDebug() << "Could't find lavfi stream:" << graph;
+        closeLavfiSource(source);
+        return false;
+    }
+
+    source->stream = source->formatCtx->streams[0];
+
+    codec = avcodec_find_decoder(source->stream->codecpar->codec_id);
+    source->codecCtx = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(source->codecCtx, source->stream->codecpar);
+
+    if (!codec || avcodec_open2(source->codecCtx, codec, NULL) < 0) {
+        qDebug() << "Could not open lavfi decoder.";
+        closeLavfiSource(source);
+        return false;
+    }
+
+    return true;
+}
+
+void closeLavfiSource(LavfiSource *source)
+{
+    avcodec_free_context(&source->codecCtx);
+    avformat_close_input(&source->formatCtx);
+    source->stream = NULL;
+}
+
+/**
+ * @brief 预先生成并解码若干帧，测试时只测量处理本身，不包含生成测试图像的耗时
+ * @return 解码出的帧，调用者用 freeFrames() 释放
+ */
+QList<AVFrame *> decodeLavfiFrames(const QString &graph, int maxFrames)
+{
+    QList<AVFrame *> frames;
+    LavfiSource source;
+    AVPacket packet;
+
+    if (!openLavfiSource(&source, graph)) {
+        return frames;
+    }
+
+    while (frames.size() < maxFrames && av_read_frame(source.formatCtx, &packet) >= 0) {
+        avcodec_send_packet(source.codecCtx, &packet);
+        av_packet_unref(&packet);
+
+        AVFrame *frame = av_frame_alloc();
+        while (frames.size() < maxFrames && avcodec_receive_frame(source.codecCtx, frame) >= 0) {
+            frames.append(frame);
+            frame = av_frame_alloc();
+        }
+        av_frame_free(&frame);
+    }
+
+    closeLavfiSource(&source);
+
+    return frames;
+}
+
+void freeFrames(QList<AVFrame *> *frames)
+{
+    for (AVFrame *frame : *frames) {
+        av_frame_free(&frame);
+    }
+    frames->clear();
+}
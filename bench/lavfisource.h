@@ -0,0 +1,30 @@
+#ifndef LAVFISOURCE_H
+#define LAVFISOURCE_H
+
+#include <QList>
+#include <QString>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+}
+
+/* 测试输入：用 lavfi 虚拟设备即时生成（如 "testsrc2=size=1280x720:rate=30"、"sine=frequency=1000"），
+ * 不需要下载或附带任何媒体文件
+ */
+struct LavfiSource {
+    AVFormatContext *formatCtx;
+    AVCodecContext *codecCtx;
+    AVStream *stream;
+};
+
+bool openLavfiSource(LavfiSource *source, const QString &graph);
+
+void closeLavfiSource(LavfiSource *source);
+
+QList<AVFrame *> decodeLavfiFrames(const QString &graph, int maxFrames);
+
+void freeFrames(QList<AVFrame *> *frames);
+
+#endif // LAVFISOURCE_H
@@ -0,0 +1,75 @@
+﻿#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+#include "libavfilter/avfilter.h"
+#include "libavdevice/avdevice.h"
+}
+
+#include "queuebench.h"
+#include "decodebench.h"
+#include "audiobench.h"
+#include "filterbench.h"
+
+/* 组件性能测试入口，结果以 JSON 输出到标准输出，便于脚本比较回归
+ * 用法：FFmpegQtPlayerBench [--packets N] [--packet-size N] [--decode 文件 [--frames N]]
+ *                           [--audio-seconds N] [--filter-frames N] [--video-size WxH] [--display-size WxH]
+ * 除 --decode 外，测试输入都由 lavfi 即时生成
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption packetsOption("packets", "Packets per queue benchmark.", "count", "1000000");
+    QCommandLineOption packetSizeOption("packet-size", "Packet payload size in bytes.", "bytes", "4096");
+    QCommandLineOption decodeOption("decode", "Media file for the video decode scaling benchmark.", "file");
+    QCommandLineOption framesOption("frames", "Maximum frames decoded per run.", "count", "1000");
+    parser.addOption(packetsOption);
+    parser.addOption(packetSizeOption);
+    parser.addOption(decodeOption);
+    QCommandLineOption audioSecondsOption("audio-seconds", "Seconds of generated audio for the decode/resample benchmark.", "seconds", "60");
+    QCommandLineOption filterFramesOption("filter-frames", "Frames per filter/convert/hand-off benchmark.", "count", "300");
+    QCommandLineOption videoSizeOption("video-size", "Generated video size.", "WxH", "1920x1080");
+    QCommandLineOption displaySizeOption("display-size", "Display size the frames are scaled to.", "WxH", "1280x720");
+    parser.addOption(framesOption);
+    parser.addOption(audioSecondsOption);
+    parser.addOption(filterFramesOption);
+    parser.addOption(videoSizeOption);
+    parser.addOption(displaySizeOption);
+    parser.process(a);
+
+    // 注册所有复用器、解复用器、编码器、解码器（新版本5.x/6.x已不需要）
+    av_register_all();
+    avfilter_register_all();
+    // lavfi 虚拟输入设备，用于生成测试音视频
+    avdevice_register_all();
+
+    QJsonObject report;
+    report["queue"] = runQueueBench(parser.value(packetsOption).toInt(), parser.value(packetSizeOption).toInt());
+
+    report["audio"] = runAudioBench(parser.value(audioSecondsOption).toInt());
+
+    QStringList videoSize   = parser.value(videoSizeOption).split('x');
+    QStringList displaySize = parser.value(displaySizeOption).split('x');
+    if (videoSize.size() == 2 && displaySize.size() == 2) {
+        report["filter"] = runFilterBench(parser.value(filterFramesOption).toInt(),
+                                          QSize(videoSize[0].toInt(), videoSize[1].toInt()),
+                                          QSize(displaySize[0].toInt(), displaySize[1].toInt()));
+    }
+
+    if (parser.isSet(decodeOption)) {
+        report["decode"] = runDecodeBench(parser.value(decodeOption), parser.value(framesOption).toInt());
+    }
+
+    QTextStream(stdout) << QJsonDocument(report).toJson();
+
+    return 0;
+}
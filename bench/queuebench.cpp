@@ -0,0 +1,156 @@
+﻿#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QQueue>
+
+#include "queuebench.h"
+#include "avpacketqueue.h"
+
+/* 原 AvPacketQueue 的实现（QQueue + SDL_mutex + SDL_cond），作为对比基准保留在测试中 */
+class MutexPacketQueue
+{
+public:
+    MutexPacketQueue()
+    {
+        mutex   = SDL_CreateMutex();
+        cond    = SDL_CreateCond();
+    }
+
+    ~MutexPacketQueue()
+    {
+        SDL_DestroyCond(cond);
+        SDL_DestroyMutex(mutex);
+    }
+
+    void enqueue(AVPacket *packet)
+    {
+        AVPacket pktInQueue;
+        av_init_packet(&pktInQueue);
+        if (av_packet_ref(&pktInQueue, packet) < 0) {
+            pktInQueue = *packet;
+        }
+
+        SDL_LockMutex(mutex);
+        queue.enqueue(pktInQueue);
+        SDL_CondSignal(cond);
+        SDL_UnlockMutex(mutex);
+
+        // 原接口只增加引用，调用者需要自己释放
+        av_packet_unref(packet);
+    }
+
+    bool dequeue(AVPacket *packet, bool isBlock)
+    {
+        bool got = false;
+
+        SDL_LockMutex(mutex);
+        while (1) {
+            if (!queue.isEmpty()) {
+                *packet = queue.dequeue();
+                got = true;
+                break;
+            } else if (!isBlock) {
+                break;
+            } else {
+                SDL_CondWait(cond, mutex);
+            }
+        }
+        SDL_UnlockMutex(mutex);
+
+        return got;
+    }
+
+    int queueSize()
+    {
+        SDL_LockMutex(mutex);
+        int size = queue.size();
+        SDL_UnlockMutex(mutex);
+
+        return size;
+    }
+
+private:
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+
+    QQueue<AVPacket> queue;
+};
+
+template <typename Queue>
+struct BenchContext
+{
+    Queue *queue;
+    int packetCount;
+    qint64 bytes;
+};
+
+// 消费者线程：阻塞取包并释放，模拟视频解码线程
+template <typename Queue>
+static int consumerThread(void *arg)
+{
+    BenchContext<Queue> *ctx = static_cast<BenchContext<Queue> *>(arg);
+    AVPacket packet;
+
+    for (int i = 0; i < ctx->packetCount; i++) {
+        if (!ctx->queue->dequeue(&packet, true)) {
+            break;
+        }
+        ctx->bytes += packet.size;
+        av_packet_unref(&packet);
+    }
+
+    return 0;
+}
+
+// 生产者在当前线程，模拟解复用线程不断分配新包并入队
+template <typename Queue>
+static QJsonObject benchQueue(const char *name, Queue *queue, int packetCount, int packetSize)
+{
+    BenchContext<Queue> ctx = {queue, packetCount, 0};
+    AVPacket packet;
+    QElapsedTimer timer;
+
+    timer.start();
+
+    SDL_Thread *consumer = SDL_CreateThread(&consumerThread<Queue>, "bench_consumer", &ctx);
+
+    for (int i = 0; i < packetCount; i++) {
+        if (av_new_packet(&packet, packetSize) < 0) {
+            break;
+        }
+        packet.duration = 1;
+        queue->enqueue(&packet);
+    }
+
+    SDL_WaitThread(consumer, NULL);
+
+    qint64 elapsed = timer.nsecsElapsed();
+
+    QJsonObject result;
+    result["bench"]         = "packet_queue";
+    result["impl"]          = name;
+    result["packets"]       = packetCount;
+    result["packet_size"]   = packetSize;
+    result["elapsed_ms"]    = elapsed / 1e6;
+    result["packets_per_sec"] = packetCount / (elapsed / 1e9);
+    result["ns_per_packet"] = static_cast<double>(elapsed) / packetCount;
+    result["bytes_ok"]      = ctx.bytes == static_cast<qint64>(packetCount) * packetSize;
+
+    return result;
+}
+
+QJsonArray runQueueBench(int packetCount, int packetSize)
+{
+    QJsonArray results;
+
+    MutexPacketQueue mutexQueue;
+    results.append(benchQueue("mutex", &mutexQueue, packetCount, packetSize));
+
+    AvPacketQueue spscQueue;
+    results.append(benchQueue("spsc", &spscQueue, packetCount, packetSize));
+
+    // 小容量环形队列，频繁触发满/空时的休眠与唤醒路径
+    AvPacketQueue smallQueue(64);
+    results.append(benchQueue("spsc_64", &smallQueue, packetCount, packetSize));
+
+    return results;
+}
@@ -0,0 +1,9 @@
+#ifndef QUEUEBENCH_H
+#define QUEUEBENCH_H
+
+#include <QJsonArray>
+
+// AvPacketQueue 吞吐量测试：单生产者/单消费者，对比无锁环形队列与原互斥锁队列
+QJsonArray runQueueBench(int packetCount, int packetSize);
+
+#endif // QUEUEBENCH_H
@@ -0,0 +1,163 @@
+﻿#include "framequeue.h"
+#include "tracer.h"
+
+/* 队列深度范围：太浅无法吸收关键帧/场景切换的解码耗时波动，太深占用内存（4K RGB 每帧数十 MB） */
+#define FRAME_QUEUE_MIN_SIZE 3
+#define FRAME_QUEUE_MAX_SIZE 8
+
+FrameQueue::FrameQueue(int capacity) :
+    readIndex(0),
+    size(0),
+    isAbort(false)
+{
+    this->capacity = FFMIN(FFMAX(capacity, FRAME_QUEUE_MIN_SIZE), FRAME_QUEUE_MAX_SIZE);
+
+    ring = new FrameSlot[this->capacity];
+    for (int i = 0; i < this->capacity; i++) {
+        ring[i].frame   = av_frame_alloc();
+        ring[i].serial  = 0;
+        ring[i].queuedAt = 0;
+    }
+
+    mutex   = SDL_CreateMutex();
+    cond    = SDL_CreateCond();
+}
+
+FrameQueue::~FrameQueue()
+{
+    for (int i = 0; i < capacity; i++) {
+        av_frame_free(&ring[i].frame);
+    }
+    delete[] ring;
+
+    SDL_DestroyCond(cond);
+    SDL_DestroyMutex(mutex);
+}
+
+/**
+ * @brief 解码帧入队，接管 frame 的引用（调用后 frame 被重置）
+ * @param serial 帧所属的播放序列号
+ * @param timeBase 帧时间戳的时间基
+ * @return true 入队成功；false 队列已被 abort，frame 被释放
+ */
+bool FrameQueue::push(AVFrame *frame, int serial, AVRational timeBase)
+{
+    // 记录解码完成的时刻，队列满时的等待也计入帧的延迟
+    qint64 queuedAt = av_gettime_relative();
+
+    SDL_LockMutex(mutex);
+
+    // 队列满：等待显示线程取走一帧
+    if (size >= capacity && !isAbort) {
+        TRACE_SCOPE("frame_queue_wait_space");
+        while (size >= capacity && !isAbort) {
+            SDL_CondWait(cond, mutex);
+        }
+    }
+
+    if (isAbort) {
+        SDL_UnlockMutex(mutex);
+        av_frame_unref(frame);
+        return false;
+    }
+
+    FrameSlot *slot = &ring[(readIndex + size) % capacity];
+    av_frame_move_ref(slot->frame, frame);
+    slot->serial = serial;
+    slot->queuedAt = queuedAt;
+    slot->timeBase = timeBase;
+    size++;
+
+    SDL_CondSignal(cond);
+    SDL_UnlockMutex(mutex);
+
+    return true;
+}
+
+/**
+ * @brief 取出队头的帧
+ * @param frame   接收帧的引用，调用者负责 unref
+ * @param serial  返回帧所属的播放序列号
+ * @param isBlock 队列为空时是否等待
+ * @param queuedAt 可选，返回帧被解码线程送入队列的时刻
+ * @param timeBase 可选，返回帧时间戳的时间基
+ * @return true 取到帧；false 队列为空（非阻塞）或已被 abort
+ */
+bool FrameQueue::pop(AVFrame *frame, int *serial, bool isBlock, qint64 *queuedAt,
+                     AVRational *timeBase)
+{
+    bool got = false;
+
+    SDL_LockMutex(mutex);
+
+    while (1) {
+        if (size > 0) {
+            FrameSlot *slot = &ring[readIndex];
+            av_frame_move_ref(frame, slot->frame);
+            *serial = slot->serial;
+            if (queuedAt) {
+                *queuedAt = slot->queuedAt;
+            }
+            if (timeBase) {
+                *timeBase = slot->timeBase;
+            }
+            readIndex = (readIndex + 1) % capacity;
+            size--;
+
+            // 通知等待空位的解码线程
+            SDL_CondSignal(cond);
+            got = true;
+            break;
+        } else if (!isBlock || isAbort) {
+            break;
+        } else {
+            TRACE_SCOPE("frame_queue_wait_frame");
+            SDL_CondWait(cond, mutex);
+        }
+    }
+
+    SDL_UnlockMutex(mutex);
+
+    return got;
+}
+
+// 丢弃队列中所有帧（seek 时使用），可以在任意线程调用
+void FrameQueue::empty()
+{
+    SDL_LockMutex(mutex);
+
+    while (size > 0) {
+        av_frame_unref(ring[readIndex].frame);
+        readIndex = (readIndex + 1) % capacity;
+        size--;
+    }
+
+    SDL_CondBroadcast(cond);
+    SDL_UnlockMutex(mutex);
+}
+
+int FrameQueue::queueSize()
+{
+    SDL_LockMutex(mutex);
+    int ret = size;
+    SDL_UnlockMutex(mutex);
+
+    return ret;
+}
+
+// 停止队列：唤醒等待的解码线程和显示线程，之后不再阻塞，直到 resume()
+void FrameQueue::abort()
+{
+    SDL_LockMutex(mutex);
+    isAbort = true;
+    SDL_CondBroadcast(cond);
+    SDL_UnlockMutex(mutex);
+}
+
+// 恢复队列的阻塞行为，开始播放新文件前调用
+void FrameQueue::resume()
+{
+    SDL_LockMutex(mutex);
+    isAbort = false;
+    SDL_UnlockMutex(mutex);
+}
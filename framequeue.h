@@ -0,0 +1,57 @@
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+extern "C"
+{
+#include "libavutil/frame.h"
+#include "libavutil/rational.h"
+#include "libavutil/time.h"
+}
+
+#include <QtGlobal>
+
+#include "SDL2/SDL.h"
+
+/* 解码后视频帧的有界队列
+ * 解码线程写入、显示线程读取，使解码可以在显示线程等待同步时继续向前解码。
+ * 帧数量很少（3 ~ 8），使用互斥锁 + 条件变量即可。
+ */
+class FrameQueue
+{
+public:
+    explicit FrameQueue(int capacity = 4);
+    ~FrameQueue();
+
+    bool push(AVFrame *frame, int serial, AVRational timeBase);
+
+    bool pop(AVFrame *frame, int *serial, bool isBlock, qint64 *queuedAt = nullptr,
+             AVRational *timeBase = nullptr);
+
+    void empty();
+
+    int queueSize();
+
+    void abort();
+
+    void resume();
+
+private:
+    struct FrameSlot {
+        AVFrame *frame;
+        int serial;         // 帧所属的播放序列号
+        qint64 queuedAt;    // 解码线程送入队列的时刻（av_gettime_relative，微秒）
+        AVRational timeBase; // 帧时间戳的时间基（经过滤镜链后可能与流不同）
+    };
+
+    FrameSlot *ring;        // 预分配的帧槽位
+    int capacity;
+    int readIndex;
+    int size;
+
+    bool isAbort;           // 停止或解码结束时唤醒所有等待者，不再阻塞
+
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+};
+
+#endif // FRAMEQUEUE_H
@@ -0,0 +1,361 @@
+﻿#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+#include "libavfilter/avfilter.h"
+}
+
+#include "headlessrunner.h"
+#include "tracer.h"
+
+HeadlessRunner::HeadlessRunner(const QString &file, const QString &type, bool isRealtime, QObject *parent) :
+    QObject(parent),
+    decoder(new MainDecoder),
+    file(file),
+    type(type),
+    isRealtime(isRealtime),
+    isFinished(false),
+    elapsed(0),
+    seekCount(0),
+    isAccurateSeek(false),
+    isScrub(false),
+    duration(0),
+    isSeeking(false)
+{
+    decoder->setFreeRun(!isRealtime);
+    decoder->setLatencyRecording(true);
+
+    connect(decoder, &MainDecoder::gotVideo,            this, &HeadlessRunner::takeVideo);
+    connect(decoder, &MainDecoder::playStateChanged,    this, &HeadlessRunner::playStateChanged);
+    connect(decoder, &MainDecoder::gotVideoTime,        this, &HeadlessRunner::videoTime);
+    connect(decoder, &MainDecoder::seekFinished,        this, &HeadlessRunner::seekFinished);
+}
+
+HeadlessRunner::~HeadlessRunner()
+{
+    delete decoder;
+}
+
+// 设置视频滤镜链，用于比较不同滤镜的开销，空字符串为旁路模式
+void HeadlessRunner::setVideoFilter(const QString &filter)
+{
+    decoder->setVideoFilter(filter);
+}
+
+// 设置预读缓冲区大小（字节），0 表示使用 FFmpeg 默认的同步读取
+void HeadlessRunner::setReadAheadSize(int size)
+{
+    decoder->setReadAheadSize(size);
+}
+
+void HeadlessRunner::setOutputFile(const QString &file)
+{
+    outputFile = file;
+}
+
+/**
+ * @brief 跳转测试：播放开始后跳转 count 次，统计从发出跳转到显示新画面的延迟
+ * @param accurate 使用精确跳转，否则跳转到关键帧后立即显示
+ * @param scrub    播放中使用拖动预览跳转（只解码关键帧、丢弃音频），统计预览画面的显示延迟
+ */
+void HeadlessRunner::setSeekTest(int count, bool accurate, bool scrub)
+{
+    seekCount       = count;
+    isAccurateSeek  = accurate;
+    isScrub         = scrub;
+    decoder->setAccurateSeek(accurate);
+}
+
+void HeadlessRunner::start()
+{
+    timer.start();
+    decoder->decoderFile(file, type);
+}
+
+// 空视频输出：像界面一样从信箱取帧，不绘制，帧随 QImage 释放回到缓冲池
+void HeadlessRunner::takeVideo()
+{
+    decoder->takeVideoFrame(&image);
+    image = QImage();
+
+    // 第一帧显示后开始跳转测试
+    if (seekCount > 0 && seekLatencies.isEmpty() && !isSeeking && !isFinished) {
+        nextSeek();
+    }
+}
+
+void HeadlessRunner::videoTime(qint64 time)
+{
+    duration = time;
+}
+
+// 依次跳转到时长的 1/(N+1)、2/(N+1) ... 处，目标一般不在整秒或关键帧上
+void HeadlessRunner::nextSeek()
+{
+    if (duration <= 0) {
+        qDebug() << "Seek test skipped: unknown duration";
+        seekCount = 0;
+        return;
+    }
+
+    qint64 pos = duration * (seekLatencies.size() + 1) / (seekCount + 1);
+
+    isSeeking = true;
+    if (isScrub) {
+        decoder->scrubProgress(pos);
+    } else {
+        decoder->seekProgress(pos);
+    }
+}
+
+void HeadlessRunner::seekFinished(qint64 latency)
+{
+    if (!isSeeking) {
+        return;
+    }
+
+    isSeeking = false;
+    seekLatencies.append(latency);
+
+    if (seekLatencies.size() < seekCount && !isFinished) {
+        nextSeek();
+    } else if (isScrub && !isFinished) {
+        // 拖动结束：跳转到最后的位置恢复完整解码和声音，不计入统计
+        decoder->seekProgress(duration * seekCount / (seekCount + 1));
+    }
+}
+
+void HeadlessRunner::playStateChanged(MainDecoder::PlayState state)
+{
+    switch (state) {
+    case MainDecoder::FINISH:
+        elapsed = timer.nsecsElapsed();
+        isFinished = true;
+        decoder->stopVideo();
+        break;
+
+    case MainDecoder::STOP:
+        // 停止后各线程已经回收，统计数据不再变化
+        if (isFinished) {
+            QByteArray json = QJsonDocument(report()).toJson();
+
+            if (outputFile.isEmpty()) {
+                QTextStream(stdout) << json;
+            } else {
+                QFile output(outputFile);
+                if (output.open(QFile::WriteOnly | QFile::Truncate)) {
+                    output.write(json);
+                } else {
+                    qDebug() << "Open report file failed:" << outputFile;
+                }
+            }
+
+            QCoreApplication::exit(0);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+// 分位数（最近秩法），samples 需已排序
+static qint64 percentile(const QVector<qint64> &samples, double p)
+{
+    if (samples.isEmpty()) {
+        return 0;
+    }
+
+    int index = qBound(0, static_cast<int>(p * samples.size() + 0.5) - 1, samples.size() - 1);
+
+    return samples[index];
+}
+
+QJsonObject HeadlessRunner::report()
+{
+    QJsonObject result;
+    QJsonObject latency;
+    QJsonObject dropped;
+    QVector<qint64> latencies = decoder->takeFrameLatencies();
+    MainDecoder::VideoDropStats stats = decoder->getVideoDropStats();
+    double seconds = elapsed / 1e9;
+
+    std::sort(latencies.begin(), latencies.end());
+
+    // 从解码完成到交给界面的延迟（微秒）
+    latency["p50"]  = percentile(latencies, 0.50);
+    latency["p90"]  = percentile(latencies, 0.90);
+    latency["p99"]  = percentile(latencies, 0.99);
+    latency["max"]  = latencies.isEmpty() ? 0 : latencies.last();
+
+    dropped["late"]             = stats.lateDropped;
+    dropped["decoder_skipped"]  = stats.decoderSkipped;
+    dropped["display_skipped"]  = stats.displaySkipped;
+
+    result["file"]              = file;
+    result["mode"]              = isRealtime ? "realtime" : "free_run";
+    result["elapsed_ms"]        = elapsed / 1e6;
+    result["frames_decoded"]    = stats.decoded;
+    result["frames_presented"]  = stats.presented;
+    result["decode_fps"]        = seconds > 0 ? stats.decoded / seconds : 0;
+    result["present_fps"]       = seconds > 0 ? stats.presented / seconds : 0;
+    result["latency_us"]        = latency;
+    result["dropped"]           = dropped;
+
+    if (seekCount > 0) {
+        QJsonObject seek;
+        QVector<qint64> seekSorted = seekLatencies;
+
+        std::sort(seekSorted.begin(), seekSorted.end());
+
+        // 从发出跳转命令到新位置的第一帧交给界面（微秒）
+        seek["mode"]        = isScrub ? "scrub" : (isAccurateSeek ? "accurate" : "fast");
+        seek["requested"]   = seekCount;
+        seek["completed"]   = seekSorted.size();
+        seek["p50_us"]      = percentile(seekSorted, 0.50);
+        seek["p90_us"]      = percentile(seekSorted, 0.90);
+        seek["max_us"]      = seekSorted.isEmpty() ? 0 : seekSorted.last();
+        result["seek"]      = seek;
+    }
+
+    // 预读 I/O：存储读取吞吐和解复用等待数据的停顿
+    ReadAheadIO::Stats ioStats = decoder->getPipelineStats().io;
+    if (ioStats.bytesRead > 0) {
+        QJsonObject io;
+
+        io["buffer_bytes"]      = decoder->getReadAheadSize();
+        io["bytes_read"]        = ioStats.bytesRead;
+        io["read_mb_per_s"]     = ioStats.readTime > 0 ? ioStats.bytesRead / 1048576.0 / (ioStats.readTime / 1e6) : 0;
+        io["stalls"]            = ioStats.stalls;
+        io["stall_ms"]          = ioStats.stallTime / 1000.0;
+        io["seeks"]             = ioStats.seeks;
+        result["io"]            = io;
+    }
+
+    // 整个进程的峰值内存和 CPU 时间
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS memory;
+    FILETIME createTime, exitTime, kernelTime, userTime;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory))) {
+        result["peak_rss_kb"] = static_cast<qint64>(memory.PeakWorkingSetSize / 1024);
+    }
+
+    if (GetProcessTimes(GetCurrentProcess(), &createTime, &exitTime, &kernelTime, &userTime)) {
+        // FILETIME 单位为 100 纳秒
+        result["cpu_user_ms"]   = ((static_cast<qint64>(userTime.dwHighDateTime) << 32) | userTime.dwLowDateTime) / 10000.0;
+        result["cpu_system_ms"] = ((static_cast<qint64>(kernelTime.dwHighDateTime) << 32) | kernelTime.dwLowDateTime) / 10000.0;
+    }
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // Linux 下 ru_maxrss 单位为 KB
+        result["peak_rss_kb"]   = static_cast<qint64>(usage.ru_maxrss);
+        result["cpu_user_ms"]   = usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0;
+        result["cpu_system_ms"] = usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+    }
+#endif
+
+    return result;
+}
+
+/**
+ * @brief 无界面性能测试入口
+ * @note  用法：FFmpegQtPlayer --headless 文件 [--realtime] [--filter 滤镜链] [--output 报告文件] [--seeks N [--accurate-seek | --scrub]]
+ *        [--read-ahead MB]
+ *        默认全速运行；--realtime 按正常播放速度运行，用于测量实时播放时的延迟和丢帧
+ */
+int runHeadless(int argc, char *argv[])
+{
+    // 没有声卡的测试机上使用 SDL 的 dummy 音频驱动，已设置时（如 disk）保持不变
+    if (qEnvironmentVariableIsEmpty("SDL_AUDIODRIVER")) {
+        qputenv("SDL_AUDIODRIVER", "dummy");
+    }
+
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption headlessOption("headless", "Play the file without GUI and print a benchmark report.", "file");
+    QCommandLineOption realtimeOption("realtime", "Play at real-time pace instead of as fast as possible.");
+    QCommandLineOption filterOption("filter", "Video filter chain, empty for bypass.", "filter");
+    QCommandLineOption outputOption("output", "Write the JSON report to this file instead of stdout.", "file");
+    QCommandLineOption seeksOption("seeks", "Seek this many times across the file and report seek latency.", "count");
+    QCommandLineOption accurateSeekOption("accurate-seek", "Seek to the exact target instead of the previous keyframe.");
+    QCommandLineOption scrubOption("scrub", "Seek with scrub previews while playing, as when dragging the progress slider.");
+    parser.addOption(headlessOption);
+    parser.addOption(realtimeOption);
+    parser.addOption(filterOption);
+    parser.addOption(outputOption);
+    parser.addOption(seeksOption);
+    QCommandLineOption readAheadOption("read-ahead", "Read-ahead buffer size in MB for local files, 0 to read synchronously.", "MB");
+    parser.addOption(accurateSeekOption);
+    parser.addOption(scrubOption);
+    parser.addOption(readAheadOption);
+    parser.process(a);
+
+    QString file = parser.value(headlessOption);
+
+    // 与 MainWindow::initFFmpeg 相同的初始化
+    avfilter_register_all();
+    av_register_all();
+    avformat_network_init();
+
+    if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_TIMER)) {
+        qDebug() << "SDL init failed";
+        return 1;
+    }
+
+    // 先探测一次文件：有视频流按视频播放，否则按音乐播放；打不开时直接退出，不进入事件循环
+    AVFormatContext *formatCtx = NULL;
+    QString type;
+
+    if (avformat_open_input(&formatCtx, file.toLocal8Bit().data(), NULL, NULL) != 0
+            || avformat_find_stream_info(formatCtx, NULL) < 0) {
+        qDebug() << "Open file failed:" << file;
+        avformat_close_input(&formatCtx);
+        return 1;
+    }
+
+    type = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0) >= 0 ? "video" : "music";
+    avformat_close_input(&formatCtx);
+
+    qRegisterMetaType<MainDecoder::PlayState>("MainDecoder::PlayState");
+
+    HeadlessRunner runner(file, type, parser.isSet(realtimeOption));
+    if (parser.isSet(filterOption)) {
+        runner.setVideoFilter(parser.value(filterOption));
+    }
+    runner.setOutputFile(parser.value(outputOption));
+    runner.setSeekTest(parser.value(seeksOption).toInt(), parser.isSet(accurateSeekOption), parser.isSet(scrubOption));
+    if (parser.isSet(readAheadOption)) {
+        runner.setReadAheadSize(parser.value(readAheadOption).toInt() * 1024 * 1024);
+    }
+    runner.start();
+
+    int ret = a.exec();
+
+#ifdef ENABLE_TRACE
+    Tracer::dumpFromEnvironment();
+#endif
+
+    SDL_Quit();
+
+    return ret;
+}
@@ -0,0 +1,63 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QObject>
+#include <QImage>
+#include <QJsonObject>
+#include <QElapsedTimer>
+
+#include "maindecoder.h"
+
+/* 无界面性能测试：用与播放器相同的 MainDecoder / AudioDecoder / AvPacketQueue 播放一个文件，
+ * 视频帧取走后直接丢弃（空视频输出），音频使用 SDL 的 dummy 驱动，
+ * 播放结束后把帧率、延迟分位数、丢帧数、峰值内存和 CPU 时间以 JSON 输出
+ */
+class HeadlessRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HeadlessRunner(const QString &file, const QString &type, bool isRealtime, QObject *parent = nullptr);
+    ~HeadlessRunner();
+
+    void start();
+    void setVideoFilter(const QString &filter);
+    void setReadAheadSize(int size);
+    void setOutputFile(const QString &file);
+    void setSeekTest(int count, bool accurate, bool scrub);
+
+private slots:
+    void takeVideo();
+    void playStateChanged(MainDecoder::PlayState state);
+    void videoTime(qint64 time);
+    void seekFinished(qint64 latency);
+
+private:
+    void nextSeek();
+    QJsonObject report();
+
+    MainDecoder *decoder;
+
+    QString file;
+    QString type;               // video / music
+    QString outputFile;         // 为空时输出到标准输出
+    bool isRealtime;            // 按实时速度播放，否则全速运行
+    bool isFinished;
+
+    QElapsedTimer timer;
+    qint64 elapsed;             // 从打开文件到播放完成的时间（纳秒）
+
+    QImage image;               // 空视频输出，只用于接收帧
+
+    /* 跳转测试：显示第一帧后依次跳转到文件中均匀分布的位置，每次显示出新位置的画面后再跳下一次；
+     * 拖动模式在播放中用拖动预览跳转，最后像松开进度条一样做一次普通跳转 */
+    int seekCount;
+    bool isAccurateSeek;
+    bool isScrub;
+    qint64 duration;            // 文件时长（微秒）
+    QVector<qint64> seekLatencies;
+    bool isSeeking;
+};
+
+int runHeadless(int argc, char *argv[]);
+
+#endif // HEADLESSRUNNER_H
@@ -0,0 +1,327 @@
+﻿#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+
+extern "C"
+{
+#include "libavutil/time.h"
+}
+
+#include "keyframeindex.h"
+#include "tracer.h"
+
+#define KEYFRAME_INDEX_VERSION  1
+
+/* 使用索引的容器：自带索引缺失或不可靠，且按字节定位后能重新同步到包边界
+ * mp4/mkv 等有完整索引的容器仍使用 av_seek_frame
+ */
+static const char *indexedFormats[] = {
+    "mpegts", "mpeg", "mpegvideo", "h264", "hevc", "m4v", "avi", "rm", "flv", NULL
+};
+
+KeyframeIndex::KeyframeIndex() :
+    streamIndex(-1),
+    fileSize(0),
+    mapped(nullptr),
+    mappedCount(0),
+    indexedPts(AV_NOPTS_VALUE),
+    tid(nullptr),
+    isAbort(0)
+{
+    mutex = SDL_CreateMutex();
+}
+
+KeyframeIndex::~KeyframeIndex()
+{
+    close();
+
+    SDL_DestroyMutex(mutex);
+}
+
+// 容器是否需要使用关键帧索引：格式在列表中、支持按字节定位，且是本地文件
+bool KeyframeIndex::isUseful(AVFormatContext *formatCtx)
+{
+    if (formatCtx->iformat->flags & AVFMT_NO_BYTE_SEEK || !formatCtx->pb || !(formatCtx->pb->seekable & AVIO_SEEKABLE_NORMAL)) {
+        return false;
+    }
+
+    // 格式名可能是逗号分隔的多个别名，如 "mov,mp4,m4a,3gp,3g2,mj2"
+    QStringList names = QString(formatCtx->iformat->name).split(',');
+
+    for (int i = 0; indexedFormats[i]; i++) {
+        if (names.contains(indexedFormats[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief 打开文件的关键帧索引：有有效的缓存时直接映射，否则启动后台线程建立索引
+ * @param file        本地文件路径
+ * @param streamIndex 要索引的流（视频流）
+ */
+void KeyframeIndex::open(const QString &file, int streamIndex)
+{
+    QFileInfo info(file);
+
+    close();
+
+    if (!info.isFile()) {
+        return;
+    }
+
+    this->file          = file;
+    this->streamIndex   = streamIndex;
+    this->fileSize      = info.size();
+
+    // 文件标识：绝对路径 + 大小 + 修改时间，任一变化都重新建立索引
+    QByteArray identity = QString("%1|%2|%3").arg(info.absoluteFilePath()).arg(info.size())
+            .arg(info.lastModified().toMSecsSinceEpoch()).toUtf8();
+    QString name = QCryptographicHash::hash(identity, QCryptographicHash::Sha1).toHex();
+
+    cachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/keyframes/" + name + ".kfi";
+
+    if (load()) {
+        qDebug() << "Keyframe index loaded:" << mappedCount << "keyframes";
+        return;
+    }
+
+    isAbort = 0;
+    tid = SDL_CreateThread(&KeyframeIndex::indexThread, "keyframe_index", this);
+}
+
+// 停止索引线程并释放索引，未建完的索引不保存
+void KeyframeIndex::close()
+{
+    isAbort = 1;
+
+    if (tid) {
+        SDL_WaitThread(tid, NULL);
+        tid = nullptr;
+    }
+
+    SDL_LockMutex(mutex);
+    if (mapped) {
+        cache.unmap(reinterpret_cast<uchar *>(const_cast<Entry *>(mapped)) - sizeof(Header));
+        mapped = nullptr;
+        mappedCount = 0;
+    }
+    cache.close();
+    entries.clear();
+    indexedPts = AV_NOPTS_VALUE;
+    SDL_UnlockMutex(mutex);
+}
+
+/**
+ * @brief 查找目标时间之前最近的关键帧
+ * @param target 目标时间（微秒，与流时间戳相同的起点）
+ * @param pts    返回关键帧的时间戳（微秒）
+ * @param pos    返回关键帧的字节位置
+ * @return false 没有索引，或索引还没扫描到目标时间
+ */
+bool KeyframeIndex::lookup(qint64 target, qint64 *pts, qint64 *pos)
+{
+    const Entry *entry = nullptr;
+
+    SDL_LockMutex(mutex);
+
+    if (mapped) {
+        entry = findEntry(mapped, mappedCount, target);
+    } else if (indexedPts != AV_NOPTS_VALUE && target <= indexedPts) {
+        entry = findEntry(entries.constData(), entries.size(), target);
+    }
+
+    if (entry) {
+        *pts = entry->pts;
+        *pos = entry->pos;
+    }
+
+    SDL_UnlockMutex(mutex);
+
+    return entry != nullptr;
+}
+
+// 二分查找 pts 不大于目标的最后一个条目，目标在第一个关键帧之前时返回第一个
+const KeyframeIndex::Entry *KeyframeIndex::findEntry(const Entry *entries, qint64 count, qint64 target)
+{
+    qint64 low = 0;
+    qint64 high = count;
+
+    if (count <= 0) {
+        return nullptr;
+    }
+
+    // 找到第一个 pts 大于目标的条目，它的前一个即为所求
+    while (low < high) {
+        qint64 middle = low + (high - low) / 2;
+
+        if (entries[middle].pts <= target) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low == 0 ? entries : entries + low - 1;
+}
+
+int KeyframeIndex::indexThread(void *arg)
+{
+    KeyframeIndex *index = (KeyframeIndex *)arg;
+
+    TRACE_THREAD_NAME("keyframe_index");
+
+    // 与播放争用 I/O 和 CPU 时让出
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    index->buildIndex();
+
+    return 0;
+}
+
+int KeyframeIndex::interruptCallback(void *arg)
+{
+    return static_cast<KeyframeIndex *>(arg)->isAbort.loadAcquire();
+}
+
+/**
+ * @brief 读一遍文件，只解复用不解码，记录所索引的流中带关键帧标记、时间戳递增的包
+ * @note  其它流设为丢弃，读完后保存到缓存文件
+ */
+void KeyframeIndex::buildIndex()
+{
+    AVFormatContext *formatCtx = avformat_alloc_context();
+    AVPacket packet;
+    AVRational timeBase;
+    qint64 lastPts = AV_NOPTS_VALUE;
+    qint64 start = av_gettime_relative();
+    bool isFinished = false;
+
+    TRACE_SCOPE("keyframe_index");
+
+    formatCtx->interrupt_callback.callback  = &KeyframeIndex::interruptCallback;
+    formatCtx->interrupt_callback.opaque    = this;
+
+    if (avformat_open_input(&formatCtx, file.toLocal8Bit().data(), NULL, NULL) != 0) {
+        return;
+    }
+
+    if (avformat_find_stream_info(formatCtx, NULL) < 0 || streamIndex >= static_cast<int>(formatCtx->nb_streams)) {
+        avformat_close_input(&formatCtx);
+        return;
+    }
+
+    for (unsigned int i = 0; i < formatCtx->nb_streams; i++) {
+        if (static_cast<int>(i) != streamIndex) {
+            formatCtx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+    timeBase = formatCtx->streams[streamIndex]->time_base;
+
+    while (!isAbort) {
+        int ret = av_read_frame(formatCtx, &packet);
+        if (ret < 0) {
+            isFinished = ret == AVERROR_EOF || avio_feof(formatCtx->pb);
+            break;
+        }
+
+        if (packet.stream_index == streamIndex) {
+            qint64 ts = packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts;
+
+            if (ts != AV_NOPTS_VALUE) {
+                ts = av_rescale_q(ts, timeBase, av_get_time_base_q());
+
+                SDL_LockMutex(mutex);
+                if ((packet.flags & AV_PKT_FLAG_KEY) && packet.pos >= 0 && (lastPts == AV_NOPTS_VALUE || ts > lastPts)) {
+                    Entry entry = {ts, packet.pos};
+                    entries.append(entry);
+                    lastPts = ts;
+                }
+                indexedPts = qMax(indexedPts, ts);
+                SDL_UnlockMutex(mutex);
+            }
+        }
+
+        av_packet_unref(&packet);
+    }
+
+    avformat_close_input(&formatCtx);
+
+    if (isFinished) {
+        SDL_LockMutex(mutex);
+        // 读完整个文件，之后的任何目标都可以使用索引
+        indexedPts = INT64_MAX;
+        SDL_UnlockMutex(mutex);
+
+        save();
+
+        qDebug() << "Keyframe index built:" << entries.size() << "keyframes in"
+                 << (av_gettime_relative() - start) / 1000 << "ms";
+    }
+}
+
+// 映射缓存文件，头部与文件不符或大小不对时视为无效
+bool KeyframeIndex::load()
+{
+    const Header *header;
+    uchar *data;
+
+    cache.setFileName(cachePath);
+    if (!cache.open(QFile::ReadOnly) || cache.size() < static_cast<qint64>(sizeof(Header))) {
+        cache.close();
+        return false;
+    }
+
+    data = cache.map(0, cache.size());
+    if (!data) {
+        cache.close();
+        return false;
+    }
+
+    header = reinterpret_cast<const Header *>(data);
+    if (memcmp(header->magic, "FQKI", 4) != 0 || header->version != KEYFRAME_INDEX_VERSION
+            || header->streamIndex != streamIndex || header->fileSize != fileSize || header->count <= 0
+            || cache.size() != static_cast<qint64>(sizeof(Header) + header->count * sizeof(Entry))) {
+        cache.unmap(data);
+        cache.close();
+        return false;
+    }
+
+    SDL_LockMutex(mutex);
+    mapped      = reinterpret_cast<const Entry *>(data + sizeof(Header));
+    mappedCount = header->count;
+    SDL_UnlockMutex(mutex);
+
+    return true;
+}
+
+// 保存索引（索引线程），先写临时文件再替换，不会留下不完整的缓存
+void KeyframeIndex::save()
+{
+    Header header;
+    QSaveFile output(cachePath);
+
+    if (entries.isEmpty() || !QDir().mkpath(QFileInfo(cachePath).path()) || !output.open(QFile::WriteOnly)) {
+        return;
+    }
+
+    memcpy(header.magic, "FQKI", 4);
+    header.version      = KEYFRAME_INDEX_VERSION;
+    header.streamIndex  = streamIndex;
+    header.reserved     = 0;
+    header.fileSize     = fileSize;
+    header.count        = entries.size();
+
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char *>(entries.constData()), entries.size() * sizeof(Entry));
+
+    if (!output.commit()) {
+        qDebug() << "Save keyframe index failed:" << cachePath;
+    }
+}
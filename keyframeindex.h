@@ -0,0 +1,76 @@
+#ifndef KEYFRAMEINDEX_H
+#define KEYFRAMEINDEX_H
+
+#include <QString>
+#include <QVector>
+#include <QFile>
+#include <QAtomicInt>
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+}
+
+#include "SDL2/SDL.h"
+
+/* 关键帧索引：后台线程用独立的 AVFormatContext 读一遍文件，记录某个流每个关键帧的（pts，字节位置），
+ * 跳转时按字节位置直接定位到目标之前最近的关键帧，不依赖容器自带的索引。
+ *
+ * 建好的索引保存在缓存目录的旁路文件中，以文件路径、大小和修改时间作为标识，
+ * 文件格式为固定头部加按 pts 升序排列的定长条目（本机字节序），再次打开时直接内存映射使用。
+ * 索引还没建完时，已扫描过的范围内同样可以使用。
+ */
+class KeyframeIndex
+{
+public:
+    KeyframeIndex();
+    ~KeyframeIndex();
+
+    static bool isUseful(AVFormatContext *formatCtx);
+
+    void open(const QString &file, int streamIndex);
+    void close();
+    bool lookup(qint64 target, qint64 *pts, qint64 *pos);
+
+private:
+    struct Header {
+        char magic[4];          // "FQKI"
+        quint32 version;
+        qint32 streamIndex;
+        quint32 reserved;
+        qint64 fileSize;
+        qint64 count;           // 条目数
+    };
+
+    struct Entry {
+        qint64 pts;             // 关键帧时间戳（微秒）
+        qint64 pos;             // 关键帧所在包的字节位置
+    };
+
+    static int indexThread(void *arg);
+    static int interruptCallback(void *arg);
+    static const Entry *findEntry(const Entry *entries, qint64 count, qint64 target);
+    void buildIndex();
+    bool load();
+    void save();
+
+    QString file;
+    QString cachePath;          // 旁路缓存文件
+    int streamIndex;
+    qint64 fileSize;
+
+    /* 已建好的索引：映射缓存文件，只读 */
+    QFile cache;
+    const Entry *mapped;
+    qint64 mappedCount;
+
+    /* 正在建立的索引，由 mutex 保护 */
+    QVector<Entry> entries;
+    qint64 indexedPts;          // 已扫描到的时间戳（微秒），小于它的目标都可以使用索引
+    SDL_mutex *mutex;
+
+    SDL_Thread *tid;            // 索引线程
+    QAtomicInt isAbort;
+};
+
+#endif // KEYFRAMEINDEX_H
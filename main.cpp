@@ -3,10 +3,25 @@
 #include <QFile>>
 
 #include "mainwindow.h"
+#include "headlessrunner.h"
+#include "synctestrunner.h"
+#include "tracer.h"
 
 
 int main(int argc, char *argv[])
 {
+    // 无界面性能测试模式，不创建窗口
+    for (int i = 1; i < argc; i++) {
+        if (qstrcmp(argv[i], "--headless") == 0) {
+            return runHeadless(argc, argv);
+        }
+
+        // 音视频同步精度测试，同样不创建窗口
+        if (qstrcmp(argv[i], "--sync-test") == 0) {
+            return runSyncTest(argc, argv);
+        }
+    }
+
     QApplication a(argc, argv);
 
     QTextCodec *codec = QTextCodec::codecForName("UTF-8");
@@ -24,7 +39,14 @@ int main(int argc, char *argv[])
     a.setStyleSheet(qss.readAll());
     qss.close();
 
-    return a.exec();
+    int ret = a.exec();
+
+#ifdef ENABLE_TRACE
+    // 设置了 FFMPEGQTPLAYER_TRACE 时退出前导出追踪文件
+    Tracer::dumpFromEnvironment();
+#endif
+
+    return ret;
 }
 
 
@@ -1,39 +1,249 @@
 ﻿#include <QDebug>
 
 #include "maindecoder.h"
+#include "tracer.h"
+
+/* 包队列容量上限：字节数或时长任一超出时阻塞解复用线程，
+ * 高码率片源受字节数约束，低码率片源受时长约束
+ */
+#define VIDEO_QUEUE_MAX_BYTES       (32 * 1024 * 1024)
+#define VIDEO_QUEUE_MAX_DURATION    (10 * AV_TIME_BASE)
+#define AUDIO_QUEUE_MAX_BYTES       (4 * 1024 * 1024)
+#define AUDIO_QUEUE_MAX_DURATION    (10 * AV_TIME_BASE)
+
+/* 自动选择线程数时的上限，与 FFmpeg 内部自动线程数的上限一致 */
+#define VIDEO_DECODE_MAX_AUTO_THREADS   16
+
+/* 解码帧队列深度：让解码线程领先显示若干帧，吸收关键帧等解码耗时的抖动 */
+#define VIDEO_FRAME_QUEUE_SIZE  4
+
+/* 显示调度
+ * 每帧的显示间隔取相邻两帧时间戳之差（支持可变帧率），时间戳不可用时取帧自身的时长；
+ * 与主时钟的偏差通过逐帧微调显示间隔平滑修正，而不是停住画面等待
+ */
+#define FRAME_DURATION_DEFAULT      0.04                // 无法得到帧时长时使用（秒）
+#define FRAME_DURATION_MAX          10.0                // 超过该值的时间戳间隔视为不连续（秒）
+#define SYNC_THRESHOLD_MIN          0.01                // 偏差小于该值时不修正（秒）
+#define SYNC_CORRECTION_RATE        0.25                // 每帧修正偏差的比例
+#define SYNC_CORRECTION_MAX         0.5                 // 每帧修正量不超过显示间隔的该比例
+#define SYNC_NOSYNC_THRESHOLD       10.0                // 偏差超过该值时认为时钟不连续，不修正（秒）
+#define SYNC_RESET_THRESHOLD        (AV_TIME_BASE / 10) // 落后计划超过该值（如暂停恢复后）时从当前时刻重新计时
+
+/* 迟到帧策略
+ * 帧落后音频时钟超过阈值时不再滤镜和显示；连续丢帧说明解码跟不上，
+ * 逐级让解码器跳过非参考帧、非关键帧，一段时间不再迟到后逐级恢复
+ */
+#define LATE_FRAME_THRESHOLD        0.1                 // 迟到阈值（秒）
+#define LATE_FRAME_MAX_CONSECUTIVE  16                  // 连续丢帧达到该数时强制显示一帧，避免画面完全停住
+#define SKIP_ESCALATE_STREAK        8                   // 连续丢帧达到该数时提高跳帧级别
+#define SKIP_ESCALATE_INTERVAL      (1 * AV_TIME_BASE)  // 两次提高级别的最小间隔，等新级别生效
+#define SKIP_RECOVER_TIME           (2 * AV_TIME_BASE)  // 持续该时长没有迟到帧时降低一级
+#define SKIP_LEVEL_MAX              2
+
+/* 精确跳转最多丢弃的帧数，超出后直接显示，避免超长 GOP 或时间戳异常时长时间没有画面 */
+#define ACCURATE_SEEK_MAX_FRAMES    900
+
+/* 默认滤镜链
+ * hb	Horizontal Deblocking	水平去块滤镜。消除水平方向上的块状效应（马赛克）。
+ * vb	Vertical Deblocking     垂直去块滤镜。消除垂直方向上的块状效应。
+ * dr	Deringing               去环效应。消除物体边缘常见的“重影”或“振铃”噪点。
+ * al	Autolevels              自动亮度/对比度。自动拉伸亮度范围，使画面层次感更强。
+ * 对码率充足的 H.264/HEVC 片源作用不大，可以通过 setVideoFilter("") 切换为旁路模式
+ */
+#define DEFAULT_VIDEO_FILTER    "pp=hb/vb/dr/al"
 
 MainDecoder::MainDecoder() :
     timeTotal(0),
+    videoTid(nullptr),
+    presentTid(nullptr),
     playState(STOP),
     isStop(false),
     isPause(false),
-    isSeek(false),
     isReadFinished(false),
+    isFinished(false),
+    abortRequest(false),
+    isFreeRun(false),
+    hasVideo(false),
+    isAccurateSeek(0),
+    seekTarget(AV_NOPTS_VALUE),
+    seekIssuedAt(0),
+    lastSeekLatency(0),
+    lastSeekDiscarded(0),
+    isScrubbing(0),
+    previewSerial(-1),
+    discardTarget(AV_NOPTS_VALUE),
+    discardedFrames(0),
+    readAheadSize(READ_AHEAD_DEFAULT_SIZE),
+    frameQueue(VIDEO_FRAME_QUEUE_SIZE),
+    masterClockType(AUDIO_CLOCK),
     audioDecoder(new AudioDecoder),
-    filterGraph(NULL)
+    isFilterInited(false),
+    videoFilter(DEFAULT_VIDEO_FILTER),
+    filterChanged(false),
+    keepAspectRatio(false),
+    displayChanged(false),
+    hasPendingImage(false),
+    imageNotified(0),
+    displaySkipped(0),
+    latencyRecording(0)
 {
-    // 清空解码线程缓存（旧API）
-    // 先初始化为默认值
-    av_init_packet(&seekPacket);
-    seekPacket.data = (uint8_t *)"FLUSH";
-    seekPacket.size = 5;
+    commandMutex    = SDL_CreateMutex();
+    commandCond     = SDL_CreateCond();
+    stateMutex      = SDL_CreateMutex();
+    stateCond       = SDL_CreateCond();
+    filterMutex     = SDL_CreateMutex();
+    imageMutex      = SDL_CreateMutex();
+    latencyMutex    = SDL_CreateMutex();
+
+    resetFilterStage(&chainStage);
+    resetFilterStage(&outputStage);
+    frameTimeBase   = av_make_q(1, AV_TIME_BASE);
+
+    // 默认按 CPU 核心数开启帧级 + 片级多线程解码
+    setVideoDecodeThreads(0, FF_THREAD_FRAME | FF_THREAD_SLICE);
+
+    videoQueue.setLimits(VIDEO_QUEUE_MAX_BYTES, VIDEO_QUEUE_MAX_DURATION);
+    audioDecoder->getPacketQueue()->setLimits(AUDIO_QUEUE_MAX_BYTES, AUDIO_QUEUE_MAX_DURATION);
 
     // 连接信号：音频播放结束 -> 通知主解码器
     connect(audioDecoder, &AudioDecoder::playFinished, this, &MainDecoder::audioFinished);
-    // 连接信号：文件读取结束 -> 通知音频解码器
-    connect(this, &MainDecoder::readFinished, audioDecoder, &AudioDecoder::readFileFinished);
+
+    // 解复用线程常驻，空闲时阻塞等待命令
+    this->start();
 }
 
 MainDecoder::~MainDecoder()
 {
+    Command cmd;
+    cmd.type = CMD_QUIT;
+    pushCommand(cmd);
+
+    wait();
 
+    delete audioDecoder;
+
+    SDL_DestroyMutex(latencyMutex);
+    SDL_DestroyMutex(imageMutex);
+    SDL_DestroyMutex(filterMutex);
+    SDL_DestroyCond(stateCond);
+    SDL_DestroyMutex(stateMutex);
+    SDL_DestroyCond(commandCond);
+    SDL_DestroyMutex(commandMutex);
 }
 
-// 显示img
+/**
+ * @brief 显示img：放入单帧信箱，覆盖界面还没取走的旧帧（显示线程）
+ * @note  只在信箱由空变为有帧时通知界面，界面再慢也不会在事件队列里积压图像
+ */
 void MainDecoder::displayVideo(QImage image)
 {
+    SDL_LockMutex(imageMutex);
+    if (hasPendingImage) {
+        // 界面来不及显示，上一帧被跳过
+        displaySkipped.fetchAndAddOrdered(1);
+    }
+    pendingImage    = image;
+    hasPendingImage = true;
+    SDL_UnlockMutex(imageMutex);
+
+    if (imageNotified.testAndSetOrdered(0, 1)) {
+        emit gotVideo();
+    }
+}
+
+/**
+ * @brief 界面线程取走信箱中最新的一帧
+ * @param image 接收图像，信箱为空时保持不变
+ * @return true 取到新的一帧
+ */
+bool MainDecoder::takeVideoFrame(QImage *image)
+{
+    bool got = false;
+
+    // 先清除通知标志再取帧，之后放入的帧会重新通知
+    imageNotified = 0;
+
+    SDL_LockMutex(imageMutex);
+    if (hasPendingImage) {
+        *image          = pendingImage;
+        pendingImage    = QImage();
+        hasPendingImage = false;
+        got = true;
+    }
+    SDL_UnlockMutex(imageMutex);
+
+    return got;
+}
+
+/**
+ * @brief 全速运行：视频不按时间戳等待、不丢迟到帧，音频不等待设备播放，用于无界面的性能测试
+ * @note  在打开文件前设置
+ */
+void MainDecoder::setFreeRun(bool freeRun)
+{
+    isFreeRun = freeRun;
+    audioDecoder->setFreeRun(freeRun);
+}
+
+/**
+ * @brief 精确跳转：从关键帧开始解码，目标之前的视频帧和音频采样解码后直接丢弃，画面和声音都从目标处开始
+ * @note  关闭时（默认）跳转到目标之前的关键帧后立即开始播放
+ */
+void MainDecoder::setAccurateSeek(bool accurate)
+{
+    isAccurateSeek = accurate;
+}
+
+bool MainDecoder::getAccurateSeek()
+{
+    return isAccurateSeek;
+}
+
+/**
+ * @brief 设置本地文件预读缓冲区大小，下次打开文件时生效
+ * @param size 字节数，0 表示关闭预读，使用 FFmpeg 默认的同步读取
+ */
+void MainDecoder::setReadAheadSize(int size)
+{
+    readAheadSize = FFMAX(size, 0);
+}
+
+int MainDecoder::getReadAheadSize()
+{
+    return readAheadSize;
+}
+
+// 开始或停止记录每帧从解码完成到交给界面的延迟
+void MainDecoder::setLatencyRecording(bool enable)
+{
+    latencyRecording = enable;
+}
+
+// 取走已记录的每帧延迟（微秒）
+QVector<qint64> MainDecoder::takeFrameLatencies()
+{
+    QVector<qint64> latencies;
+
+    SDL_LockMutex(latencyMutex);
+    latencies.swap(frameLatencies);
+    SDL_UnlockMutex(latencyMutex);
+
+    return latencies;
+}
+
+// 设置音频输出监听（测试用），转交给音频解码器
+void MainDecoder::setAudioOutputTap(AudioDecoder::OutputTap tap, void *opaque)
+{
+    audioDecoder->setOutputTap(tap, opaque);
+}
 
-    emit gotVideo(image);
+// 丢弃信箱中还没显示的帧（停止播放时）
+void MainDecoder::clearVideoFrame()
+{
+    SDL_LockMutex(imageMutex);
+    pendingImage    = QImage();
+    hasPendingImage = false;
+    SDL_UnlockMutex(imageMutex);
 }
 
 // 重置播放器状态
@@ -48,15 +258,62 @@ void MainDecoder::clearData()
 
     isStop  = false;
     isPause = false;
-    isSeek  = false;
-    isReadFinished      = false;
-    isDecodeFinished    = false;
+    isReadFinished  = false;
+    isFinished      = false;
+
+    videoTid    = nullptr;
+    presentTid  = nullptr;
 
     videoQueue.empty();
+    videoQueue.resume();
 
-    audioDecoder->emptyAudioData();
+    frameQueue.empty();
+    frameQueue.resume();
 
-    videoClk = 0;
+    audioDecoder->setSeekTarget(AV_NOPTS_VALUE);
+    audioDecoder->emptyAudioData();
+    audioDecoder->getPacketQueue()->resume();
+
+    seekTarget          = AV_NOPTS_VALUE;
+    seekIssuedAt        = 0;
+    lastSeekLatency     = 0;
+    lastSeekDiscarded   = 0;
+    isScrubbing         = 0;
+    previewSerial       = -1;
+    discardTarget       = AV_NOPTS_VALUE;
+    discardedFrames     = 0;
+
+    videoSerial = -1;
+    presentSerial = -1;
+    isSeekPending = false;
+
+    frameTimer          = 0;
+    lastFramePts        = 0;
+    lastFrameDuration   = FRAME_DURATION_DEFAULT;
+
+    // 从 0 开始走时，实际起点在第一帧显示时对齐
+    videoClock.setPaused(false);
+    videoClock.set(0);
+    externalClock.setPaused(false);
+    externalClock.set(0);
+
+    lateFramesDropped   = 0;
+    displaySkipped      = 0;
+    syncErrorSum        = 0;
+    syncErrorCount      = 0;
+    jitterSum           = 0;
+    jitterCount         = 0;
+    videoPacketsSent    = 0;
+    videoFramesDecoded  = 0;
+    videoFramesPresented = 0;
+    hasVideo            = false;
+
+    demuxCounter.reset();
+    decodeCounter.reset();
+    filterCounter.reset();
+    convertCounter.reset();
+    appliedSkipLevel    = 0;
+    resetFrameDropping();
 }
 
 // 更新播放状态
@@ -68,6 +325,21 @@ void MainDecoder::setPlayState(MainDecoder::PlayState state)
     playState = state;
 }
 
+// 播放完成，音频和视频都可能通知，只向主线程发送一次
+void MainDecoder::finishPlay()
+{
+    if (isFinished.testAndSetOrdered(0, 1)) {
+        setPlayState(MainDecoder::FINISH);
+    }
+}
+
+// 阻塞 I/O（打开文件、读取数据包）期间由 FFmpeg 定期调用，返回非 0 时立即中断
+int MainDecoder::interruptCallback(void *arg)
+{
+    MainDecoder *decoder = (MainDecoder *)arg;
+
+    return decoder->abortRequest;
+}
 // 判断是否为实时流
 bool MainDecoder::isRealtime(AVFormatContext *pFormatCtx)
 {
@@ -87,451 +359,1481 @@ bool MainDecoder::isRealtime(AVFormatContext *pFormatCtx)
     return false;
 }
 
-// 初始化滤镜
-int MainDecoder::initFilter()
+// 输出级的缩放滤镜：按当前窗口大小和长宽比模式缩放，不需要缩放时返回空字符串
+QString MainDecoder::outputScaleFilter(int width, int height, AVRational sar)
+{
+    QSize target;
+    bool keepRatio;
+
+    SDL_LockMutex(commandMutex);
+    target      = displaySize;
+    keepRatio   = keepAspectRatio;
+    SDL_UnlockMutex(commandMutex);
+
+    return ::outputScaleFilter(width, height, sar, target, keepRatio);
+}
+
+/**
+ * @brief （重新）创建一级滤镜：buffer -> desc -> buffersink，输入参数取自 frame
+ * @param name        统计名称，与原来相同时（跳转、窗口大小改变后重建）继续累计耗时
+ * @param timeBase    frame 的时间基
+ * @param isRgbOutput 输出级，输出 RGB32
+ */
+int MainDecoder::createFilterStage(FilterStage *stage, const QString &name, const QString &desc,
+                                   const AVFrame *frame, AVRational timeBase, bool isRgbOutput)
 {
     int ret;
+    VideoFilterGraph filter;
+
+    freeFilterStage(stage);
+
+    ret = createVideoFilter(&filter, desc, frame->width, frame->height,
+                            (AVPixelFormat)frame->format, timeBase, frame->sample_aspect_ratio, isRgbOutput);
+    if (ret < 0) {
+        return ret;
+    }
+
+    SDL_LockMutex(filterMutex);
+    if (name != stage->name) {
+        stage->totalTime    = 0;
+        stage->frames       = 0;
+    }
+    stage->name     = name;
+    stage->filter   = filter;
+    stage->width    = frame->width;
+    stage->height   = frame->height;
+    stage->format   = frame->format;
+    stage->sar      = frame->sample_aspect_ratio;
+    SDL_UnlockMutex(filterMutex);
+
+    return ret;
+}
+
+// 帧的尺寸、像素格式或宽高比与这一级滤镜创建时不同，需要重建（如码流中途改变分辨率）
+bool MainDecoder::isStageInputChanged(const FilterStage &stage, const AVFrame *frame)
+{
+    return frame->width != stage.width || frame->height != stage.height || frame->format != stage.format
+            || av_cmp_q(frame->sample_aspect_ratio, stage.sar) != 0;
+}
+
+/**
+ * @brief 按当前滤镜配置创建滤镜链（解码线程），原有的滤镜链连同其中缓存的帧一起释放
+ * @note  整条滤镜链放在一个 graph 中，滤镜之间只做一次格式协商，不会在每个滤镜之间插入转换；
+ *        缩放和 RGB32 转换是单独的输出级（见 convertFrame）。创建失败时退回旁路模式
+ */
+int MainDecoder::initFilter(const AVFrame *frame)
+{
+    int ret = 0;
+    QString filter = currentVideoFilter();
+
+    freeFilterStage(&chainStage);
+
+    activeFilter    = filter;
+    isFilterInited  = true;
+
+    if (filter.isEmpty()) {
+        return 0;
+    }
+
+    ret = createFilterStage(&chainStage, filter, filter, frame, videoStream->time_base, false);
+    if (ret < 0) {
+        qDebug() << "Init video filter" << filter << "failed, fall back to bypass.";
+    }
+
+    return ret;
+}
+
+// 释放一级滤镜的 graph，统计数据保留
+void MainDecoder::freeFilterStage(FilterStage *stage)
+{
+    VideoFilterGraph filter;
+
+    SDL_LockMutex(filterMutex);
+    filter = stage->filter;
+    stage->filter.graph = NULL;
+    stage->filter.src   = NULL;
+    stage->filter.sink  = NULL;
+    SDL_UnlockMutex(filterMutex);
+
+    freeVideoFilter(&filter);
+}
+
+// 清空一级滤镜的配置和统计（graph 已释放）
+void MainDecoder::resetFilterStage(FilterStage *stage)
+{
+    SDL_LockMutex(filterMutex);
+    stage->name.clear();
+    stage->filter.graph = NULL;
+    stage->filter.src   = NULL;
+    stage->filter.sink  = NULL;
+    stage->width        = 0;
+    stage->height       = 0;
+    stage->format       = AV_PIX_FMT_NONE;
+    stage->sar          = av_make_q(0, 1);
+    stage->totalTime    = 0;
+    stage->frames       = 0;
+    SDL_UnlockMutex(filterMutex);
+}
+
+// 累计一级滤镜的耗时，frames 为处理的输入帧数
+void MainDecoder::addFilterCost(FilterStage *stage, qint64 time, int frames)
+{
+    SDL_LockMutex(filterMutex);
+    stage->totalTime += time;
+    stage->frames    += frames;
+    SDL_UnlockMutex(filterMutex);
+}
+
+// 释放滤镜链和输出级（解码线程和显示线程都已退出），释放前输出各级滤镜的耗时统计
+void MainDecoder::freeFilter()
+{
+    QList<FilterCost> costs = getVideoFilterCosts();
+    for (const FilterCost &cost : costs) {
+        if (cost.frames > 0) {
+            qDebug() << "Video filter" << cost.name << ", frames:" << cost.frames << ", average cost:" << cost.averageTime << "us";
+        }
+    }
+
+    freeFilterStage(&chainStage);
+    freeFilterStage(&outputStage);
+    resetFilterStage(&chainStage);
+    resetFilterStage(&outputStage);
+
+    activeFilter.clear();
+    isFilterInited = false;
+}
+
+/**
+ * @brief 解码出的帧送入滤镜链，滤镜链的全部输出送入帧队列（解码线程）
+ * @note  旁路模式直接送入帧队列；frame 的引用被接管
+ * @return false 帧队列已停止
+ */
+bool MainDecoder::queueFrame(AVFrame *frame)
+{
+    int ret;
+    qint64 start;
+
+    // 第一帧、跳转或切换滤镜之后，以及帧参数变化时（重新）创建滤镜链
+    if (!isFilterInited || (chainStage.filter.graph && isStageInputChanged(chainStage, frame))) {
+        initFilter(frame);
+    }
+
+    if (!chainStage.filter.graph) {
+        return frameQueue.push(frame, videoSerial, videoStream->time_base);
+    }
+
+    start = av_gettime_relative();
+    ret = av_buffersrc_add_frame(chainStage.filter.src, frame);
+    if (ret < 0) {
+        qDebug() << "av buffersrc add frame failed, filter:" << chainStage.name;
+        av_frame_unref(frame);
+        return true;
+    }
+
+    return drainFilter(frame, av_gettime_relative() - start, 1);
+}
+
+/**
+ * @brief 取出滤镜链的全部输出帧送入帧队列，直到 EAGAIN / EOF（解码线程）
+ * @note  一帧输入可能得到多帧（如 yadif=1、fps 提高帧率）或暂时没有输出（滤镜在等后面的帧），
+ *        只取一帧的话多出来的帧会一直堆在 buffersink 里，画面越来越落后
+ * @param frame     用于接收输出帧的空帧
+ * @param filterTime 送入这一帧已花费的时间（微秒）
+ * @param frames    送入的帧数，计入统计
+ * @return false 帧队列已停止
+ */
+bool MainDecoder::drainFilter(AVFrame *frame, qint64 filterTime, int frames)
+{
+    int ret;
+    bool isQueued = true;
+    AVFilterContext *sink = chainStage.filter.sink;
+    AVRational timeBase = av_buffersink_get_time_base(sink);
+    AVRational frameRate = av_buffersink_get_frame_rate(sink);
+
+    while (true) {
+        qint64 start = av_gettime_relative();
+        ret = av_buffersink_get_frame(sink, frame);
+        filterTime += av_gettime_relative() - start;
+
+        if (ret < 0) {
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+                qDebug() << "av buffersink get frame failed, filter:" << chainStage.name;
+            }
+            break;
+        }
+
+        // 滤镜不会换算 pkt_duration，按滤镜链的输出帧率重新设置，单位为输出时间基
+        frame->pkt_duration = frameRate.num > 0 && frameRate.den > 0 ?
+                              av_rescale_q(1, av_inv_q(frameRate), timeBase) : 0;
+
+        // 帧队列满时阻塞，不计入滤镜耗时
+        if (!frameQueue.push(frame, videoSerial, timeBase)) {
+            isQueued = false;
+            break;
+        }
+    }
+
+    addFilterCost(&chainStage, filterTime, frames);
+    filterCounter.add(filterTime);
+
+    return isQueued;
+}
+
+// 文件读完：冲刷滤镜链，取出滤镜内部缓存的最后几帧（解码线程）
+void MainDecoder::flushFilter()
+{
+    AVFrame *frame;
+    qint64 start;
+
+    if (!chainStage.filter.graph) {
+        return;
+    }
+
+    frame = av_frame_alloc();
+
+    start = av_gettime_relative();
+    if (av_buffersrc_add_frame(chainStage.filter.src, NULL) >= 0) {
+        drainFilter(frame, av_gettime_relative() - start, 0);
+    }
+
+    av_frame_free(&frame);
+}
+
+/**
+ * @brief 输出级：缩放到窗口大小并转换为 RGB32，结果写回 frame（显示线程）
+ * @note  输入参数取自要显示的帧，滤镜链的输出尺寸或格式变化、窗口大小变化时重建；
+ *        只有 scale / setsar，一帧进一帧出，不会缓存帧。失败时 frame 已被 unref
+ * @param timeBase frame 的时间基
+ */
+bool MainDecoder::convertFrame(AVFrame *frame, AVRational timeBase)
+{
+    int ret;
+    qint64 start;
+
+    if (!outputStage.filter.graph || isStageInputChanged(outputStage, frame)) {
+        QString desc = outputScaleFilter(frame->width, frame->height, frame->sample_aspect_ratio);
+
+        if (createFilterStage(&outputStage, "convert", desc, frame, timeBase, true) < 0) {
+            av_frame_unref(frame);
+            return false;
+        }
+    }
+
+    start = av_gettime_relative();
+
+    if (av_buffersrc_add_frame(outputStage.filter.src, frame) < 0) {
+        qDebug() << "av buffersrc add frame failed, filter:" << outputStage.name;
+        av_frame_unref(frame);
+        return false;
+    }
+
+    ret = av_buffersink_get_frame(outputStage.filter.sink, frame);
+
+    addFilterCost(&outputStage, av_gettime_relative() - start, 1);
+
+    if (ret < 0) {
+        qDebug() << "av buffersink get frame failed, filter:" << outputStage.name;
+        return false;
+    }
+
+    return true;
+}
+
+// 当前文件使用的滤镜链：有单独配置时使用文件的配置，否则使用全局配置
+QString MainDecoder::currentVideoFilter()
+{
+    QString filter;
+
+    SDL_LockMutex(commandMutex);
+    filter = fileVideoFilters.value(currentFile, videoFilter);
+    SDL_UnlockMutex(commandMutex);
+
+    return filter;
+}
+
+/**
+ * @brief 设置视频滤镜链，播放过程中设置会在下一帧重建滤镜，不需要重新打开文件和解码器
+ * @param filter 逗号分隔的 FFmpeg 滤镜链，如 "pp=hb/vb/dr/al" 或 "hqdn3d,unsharp"；
+ *               空字符串表示旁路模式，只做像素格式转换
+ * @param file   只对该文件生效，为空时设置全局配置
+ */
+void MainDecoder::setVideoFilter(const QString &filter, const QString &file)
+{
+    SDL_LockMutex(commandMutex);
+    if (file.isEmpty()) {
+        videoFilter = filter;
+    } else {
+        fileVideoFilters[file] = filter;
+    }
+    SDL_UnlockMutex(commandMutex);
+
+    // 通知解码线程检查是否需要重建
+    filterChanged = true;
+}
+
+// 取消文件单独的滤镜配置，恢复使用全局配置
+void MainDecoder::resetVideoFilter(const QString &file)
+{
+    SDL_LockMutex(commandMutex);
+    fileVideoFilters.remove(file);
+    SDL_UnlockMutex(commandMutex);
+
+    filterChanged = true;
+}
+
+/**
+ * @brief 设置视频显示区域，解码管线直接输出该尺寸的图像，界面绘制时不需要再缩放
+ * @param size            显示区域大小，为空时输出原始分辨率
+ * @param keepAspectRatio 是否保持视频长宽比，否则拉伸填满显示区域
+ */
+void MainDecoder::setDisplaySize(QSize size, bool keepAspectRatio)
+{
+    SDL_LockMutex(commandMutex);
+    displaySize             = size;
+    this->keepAspectRatio   = keepAspectRatio;
+    SDL_UnlockMutex(commandMutex);
+
+    // 通知显示线程在下一帧重建输出级
+    displayChanged = true;
+}
+
+// 获取滤镜耗时统计：滤镜链整体一项（按送入的解码帧计），"convert" 为缩放和 RGB32 转换，可在任意线程调用
+QList<MainDecoder::FilterCost> MainDecoder::getVideoFilterCosts()
+{
+    QList<FilterCost> costs;
+
+    const FilterStage *stages[] = {&chainStage, &outputStage};
+
+    SDL_LockMutex(filterMutex);
+    for (const FilterStage *stage : stages) {
+        if (stage->name.isEmpty()) {
+            continue;
+        }
+
+        FilterCost cost;
+        cost.name           = stage->name;
+        cost.frames         = stage->frames;
+        cost.averageTime    = stage->frames > 0 ? stage->totalTime / stage->frames : 0;
+        costs.append(cost);
+    }
+    SDL_UnlockMutex(filterMutex);
+
+    return costs;
+}
+
+// 主线程请求播放文件，只投递命令，不等待旧文件停止
+void MainDecoder::decoderFile(QString file, QString type)
+{
+    qDebug() << "File name:" << file << ", type:" << type;
+
+    Command cmd;
+    cmd.type        = CMD_OPEN;
+    cmd.file        = file;
+    cmd.fileType    = type;
+    pushCommand(cmd);
+}
+
+// 音频解码线程通知音频播放完成
+void MainDecoder::audioFinished()
+{
+    // 全速运行时音频不等待设备播放，会先于视频结束，以视频显示完为准
+    if (isFreeRun && hasVideo) {
+        return;
+    }
+
+    // 音频播放完成，视频也随之结束
+    finishPlay();
+}
+
+// 主线程通知停止播放
+void MainDecoder::stopVideo()
+{
+    Command cmd;
+    cmd.type = CMD_STOP;
+    pushCommand(cmd);
+}
+
+// 主线程通知暂停或回复播放
+void MainDecoder::pauseVideo()
+{
+    Command cmd;
+    cmd.type = CMD_PAUSE;
+    pushCommand(cmd);
+}
+
+/**
+ * @brief 投递控制命令（任意线程调用），由解复用线程异步处理
+ * @note  停止/打开命令会打断正在阻塞的 I/O 和队列等待，使旧文件尽快退出
+ */
+void MainDecoder::pushCommand(Command cmd)
+{
+    cmd.issuedAt = av_gettime_relative();
+
+    SDL_LockMutex(commandMutex);
+
+    if (cmd.type == CMD_SEEK) {
+        // 上一次跳转还没处理时直接用新的请求替换它，只执行最后一次（拖动进度条时每秒会有几十次请求）
+        for (Command &pending : commandQueue) {
+            if (pending.type == CMD_SEEK) {
+                pending = cmd;
+                SDL_UnlockMutex(commandMutex);
+                return;
+            }
+        }
+    }
+
+    if (cmd.type == CMD_OPEN || cmd.type == CMD_STOP || cmd.type == CMD_QUIT) {
+        abortRequest = true;
+    }
+
+    commandQueue.enqueue(cmd);
+    SDL_CondSignal(commandCond);
+    SDL_UnlockMutex(commandMutex);
+
+    // 解复用线程可能正阻塞在已满的队列上，唤醒它处理命令
+    videoQueue.wakeup();
+    audioDecoder->getPacketQueue()->wakeup();
+}
+
+// 空闲时阻塞取出下一条命令
+bool MainDecoder::takeCommand(Command *cmd)
+{
+    SDL_LockMutex(commandMutex);
+
+    while (commandQueue.isEmpty()) {
+        SDL_CondWait(commandCond, commandMutex);
+    }
+
+    *cmd = commandQueue.dequeue();
+
+    // 队列里还有停止/打开命令时保持中断请求，否则允许新文件正常进行 I/O
+    abortRequest = false;
+    for (const Command &pending : commandQueue) {
+        if (pending.type == CMD_OPEN || pending.type == CMD_STOP || pending.type == CMD_QUIT) {
+            abortRequest = true;
+        }
+    }
+
+    SDL_UnlockMutex(commandMutex);
+
+    return true;
+}
+
+/**
+ * @brief 播放过程中处理暂停和跳转命令
+ * @param isBlock 队列中没有命令时是否阻塞等待（暂停或文件已读完时使用）
+ * @note  遇到停止/打开/退出命令时不取出，只设置停止标志，由 run() 在退出播放后处理
+ */
+void MainDecoder::processCommands(bool isBlock)
+{
+    Command cmd;
+
+    while (1) {
+        SDL_LockMutex(commandMutex);
+
+        if (commandQueue.isEmpty()) {
+            if (!isBlock) {
+                SDL_UnlockMutex(commandMutex);
+                return;
+            }
+            SDL_CondWait(commandCond, commandMutex);
+            SDL_UnlockMutex(commandMutex);
+            continue;
+        }
+
+        CommandType type = commandQueue.head().type;
+        if (type == CMD_OPEN || type == CMD_STOP || type == CMD_QUIT) {
+            isStop = true;
+            SDL_UnlockMutex(commandMutex);
+            return;
+        }
+
+        cmd = commandQueue.dequeue();
+        SDL_UnlockMutex(commandMutex);
+
+        if (cmd.type == CMD_PAUSE) {
+            togglePause();
+        } else if (cmd.type == CMD_SEEK) {
+            doSeek(cmd.pos, cmd.issuedAt, cmd.isScrub);
+        }
+
+        // 处理完一条命令后，剩下的命令不再阻塞等待
+        isBlock = false;
+    }
+}
+
+// 暂停或恢复播放（解复用线程）
+void MainDecoder::togglePause()
+{
+    SDL_LockMutex(stateMutex);
+    isPause = !isPause;
+    // 唤醒等待恢复的视频显示线程
+    SDL_CondBroadcast(stateCond);
+    SDL_UnlockMutex(stateMutex);
+
+    // 通知音频解码线程暂停或者恢复播放
+    if (audioIndex >= 0) {
+        audioDecoder->pauseAudio(isPause);
+    }
+
+    videoClock.setPaused(isPause);
+    externalClock.setPaused(isPause);
+
+    if (isPause) {
+        // 通知数据源暂停
+        av_read_pause(pFormatCtx);
+        // 改变本线程状态
+        setPlayState(PAUSE);
+    } else {
+        // 通知数据源继续
+        av_read_play(pFormatCtx);
+        // 改变本线程状态
+        setPlayState(PLAYING);
+    }
+}
+
+// 视频显示线程在暂停时阻塞，直到恢复播放或停止
+void MainDecoder::waitForResume()
+{
+    SDL_LockMutex(stateMutex);
+    while (isPause && !isStop && previewSerial < 0) {
+        SDL_CondWait(stateCond, stateMutex);
+    }
+    SDL_UnlockMutex(stateMutex);
+}
+
+// 主线程获取音量
+int MainDecoder::getVolume()
+{
+    return audioDecoder->getVolume();
+}
+
+// 主线程设置音量
+void MainDecoder::setVolume(int volume)
+{
+    audioDecoder->setVolume(volume);
+}
+
+/**
+ * @brief 设置视频解码线程数和多线程方式，在下一次打开文件时生效
+ * @param threadCount 线程数，<= 0 表示使用 CPU 核心数，1 表示单线程解码
+ * @param threadType  FF_THREAD_FRAME（帧级，吞吐高但增加 threadCount - 1 帧延迟）、
+ *                    FF_THREAD_SLICE（片级，无额外延迟，需码流分片）或两者组合
+ * @param codecId     只对该解码器生效，AV_CODEC_ID_NONE 表示默认配置
+ */
+void MainDecoder::setVideoDecodeThreads(int threadCount, int threadType, AVCodecID codecId)
+{
+    DecodeThreadConfig config;
+    config.threadCount  = threadCount;
+    config.threadType   = threadType;
+
+    // 配置会在解复用线程打开文件时读取，与命令队列共用一把锁
+    SDL_LockMutex(commandMutex);
+    decodeThreadConfigs[codecId] = config;
+    SDL_UnlockMutex(commandMutex);
+}
+
+// 打开解码器前设置多线程参数，解码器不支持的线程方式会被去掉
+void MainDecoder::configureDecodeThreads(AVCodecContext *codecCtx, AVCodec *codec)
+{
+    DecodeThreadConfig config;
+
+    SDL_LockMutex(commandMutex);
+    config = decodeThreadConfigs.value(codec->id, decodeThreadConfigs.value(AV_CODEC_ID_NONE));
+    SDL_UnlockMutex(commandMutex);
+
+    if (config.threadCount <= 0) {
+        config.threadCount = FFMIN(QThread::idealThreadCount(), VIDEO_DECODE_MAX_AUTO_THREADS);
+    }
+
+    if (!(codec->capabilities & AV_CODEC_CAP_FRAME_THREADS)) {
+        config.threadType &= ~FF_THREAD_FRAME;
+    }
+    if (!(codec->capabilities & AV_CODEC_CAP_SLICE_THREADS)) {
+        config.threadType &= ~FF_THREAD_SLICE;
+    }
+
+    codecCtx->thread_count  = FFMAX(config.threadCount, 1);
+    codecCtx->thread_type   = config.threadType;
+}
+
+// 获取视频丢帧统计，可在任意线程调用
+MainDecoder::VideoDropStats MainDecoder::getVideoDropStats()
+{
+    VideoDropStats stats;
+
+    stats.decoded           = videoFramesDecoded;
+    stats.presented         = videoFramesPresented;
+    stats.lateDropped       = lateFramesDropped;
+    stats.decoderSkipped    = FFMAX(videoPacketsSent - videoFramesDecoded, 0);
+    stats.skipLevel         = skipLevel;
+    stats.displaySkipped    = displaySkipped;
+
+    return stats;
+}
+
+// 读取一个阶段的统计
+static MainDecoder::PipelineStats::Stage stageStats(StageCounter &counter)
+{
+    MainDecoder::PipelineStats::Stage stage;
+
+    stage.count     = counter.count();
+    stage.totalTime = counter.totalTime();
+    stage.maxTime   = counter.takeMaxTime();
+
+    return stage;
+}
+
+/**
+ * @brief 获取管线各阶段的统计（界面线程，定时调用）
+ * @note  各项分别无锁读取，彼此之间不是同一时刻的快照，用于观察足够了
+ */
+MainDecoder::PipelineStats MainDecoder::getPipelineStats()
+{
+    PipelineStats stats;
+    AvPacketQueue *audioQueue = audioDecoder->getPacketQueue();
+
+    stats.demux     = stageStats(demuxCounter);
+    stats.decode    = stageStats(decodeCounter);
+    stats.filter    = stageStats(filterCounter);
+    stats.convert   = stageStats(convertCounter);
+
+    stats.videoPackets  = videoQueue.queueSize();
+    stats.videoBytes    = videoQueue.queueBytes();
+    stats.videoDuration = videoQueue.queueDuration();
+    stats.audioPackets  = audioQueue->queueSize();
+    stats.audioBytes    = audioQueue->queueBytes();
+    stats.audioDuration = audioQueue->queueDuration();
+    stats.decodedFrames = frameQueue.queueSize();
+
+    stats.avDrift = 0;
+    if (hasVideo && audioIndex >= 0 && playState != STOP) {
+        stats.avDrift = videoClock.get() - audioDecoder->getAudioClock();
+    }
+
+    stats.drops = getVideoDropStats();
+
+    stats.seekLatency   = lastSeekLatency;
+    stats.seekDiscarded = lastSeekDiscarded;
+
+    stats.io = readAhead.getStats();
+
+    return stats;
+}
+
+// 主线程获取当前时间（主时钟）
+double MainDecoder::getCurrentTime()
+{
+    return getMasterClock();
+}
+
+/**
+ * @brief 选择主时钟，播放过程中也可以切换
+ * @note  选择音频时钟但文件没有音频时使用外部时钟；选择视频时钟但没有视频时使用音频时钟
+ */
+void MainDecoder::setMasterClock(ClockType type)
+{
+    masterClockType = type;
+}
+
+// 实际使用的主时钟（考虑了流缺失时的回退）
+MainDecoder::ClockType MainDecoder::getMasterClockType()
+{
+    ClockType type = static_cast<ClockType>(masterClockType.load());
+
+    if (type == VIDEO_CLOCK && (videoIndex < 0 || currentType != "video")) {
+        type = AUDIO_CLOCK;
+    }
+
+    if (type == AUDIO_CLOCK && audioIndex < 0) {
+        type = EXTERNAL_CLOCK;
+    }
+
+    return type;
+}
+
+// 主时钟当前时间（秒），可在任意线程调用
+double MainDecoder::getMasterClock()
+{
+    switch (getMasterClockType()) {
+    case AUDIO_CLOCK:
+        return audioDecoder->getAudioClock();
+    case VIDEO_CLOCK:
+        return videoClock.get();
+    default:
+        return externalClock.get();
+    }
+}
+
+// 主线程跳转请求
+void MainDecoder::seekProgress(qint64 pos)
+{
+    Command cmd;
+    cmd.type    = CMD_SEEK;
+    cmd.pos     = pos;
+    cmd.isScrub = false;
+    pushCommand(cmd);
+}
+
+/**
+ * @brief 拖动进度条时的预览跳转：只解码关键帧并立即显示（暂停时也显示），不播放声音
+ * @note  拖动结束后应调用 seekProgress() 跳转到最终位置，恢复完整解码
+ */
+void MainDecoder::scrubProgress(qint64 pos)
+{
+    Command cmd;
+    cmd.type    = CMD_SEEK;
+    cmd.pos     = pos;
+    cmd.isScrub = true;
+    pushCommand(cmd);
+}
+
+
+/**
+ * @brief 帧自身的显示时长（秒）
+ * @note  优先使用包携带的时长（经过滤镜链的帧为滤镜链输出帧率对应的时长），没有时按流的帧率推算；
+ *        不能用解码器的 time_base，很多编码器的 time_base 并不等于帧间隔
+ */
+double MainDecoder::frameDuration(AVFrame *frame)
+{
+    double duration = 0;
+
+    if (frame->pkt_duration > 0) {
+        duration = frame->pkt_duration * av_q2d(frameTimeBase);
+    } else {
+        AVRational frameRate = av_guess_frame_rate(pFormatCtx, videoStream, frame);
+        if (frameRate.num > 0 && frameRate.den > 0) {
+            duration = av_q2d(av_inv_q(frameRate));
+            // 软件重复场（如 3:2 下拉）延长显示时间
+            duration += frame->repeat_pict * (duration * 0.5);
+        }
+    }
+
+    if (duration <= 0 || duration > FRAME_DURATION_MAX) {
+        duration = lastFrameDuration;
+    }
+
+    return duration;
+}
+
+/**
+ * @brief 计算上一帧到这一帧的显示间隔（秒）
+ * @note  间隔取两帧时间戳之差，可变帧率的片源每帧间隔不同；
+ *        主时钟不是视频时钟时，按视频与主时钟的偏差微调间隔，偏差在若干帧内逐渐消除
+ */
+double MainDecoder::frameDelay(double framePts, ClockType clockType)
+{
+    double delay = framePts - lastFramePts;
+
+    // 第一帧、时间戳回退或跳变：按上一帧自身的时长显示
+    if (frameTimer == 0 || delay <= 0 || delay > FRAME_DURATION_MAX) {
+        delay = lastFrameDuration;
+    }
+
+    if (clockType != VIDEO_CLOCK) {
+        // 视频时钟从上一帧显示时开始走时，正值表示视频超前于主时钟
+        double diff = videoClock.get() - getMasterClock();
+
+        if (qAbs(diff) > SYNC_THRESHOLD_MIN && qAbs(diff) < SYNC_NOSYNC_THRESHOLD) {
+            double correction = diff * SYNC_CORRECTION_RATE;
+            correction = qBound(-delay * SYNC_CORRECTION_MAX, correction, delay * SYNC_CORRECTION_MAX);
+            delay += correction;
+        }
+    }
+
+    return delay;
+}
+
+/**
+ * @brief 休眠到目标时刻（显示线程）
+ * @note  一次定时等待，暂停、停止或跳转时提前唤醒；条件变量只有毫秒精度，最后不足 1 毫秒的部分用 av_usleep 补齐
+ * @return true 到达目标时刻；false 被暂停、停止或跳转打断
+ */
+bool MainDecoder::waitUntil(qint64 target, int serial)
+{
+    bool ret = true;
+
+    SDL_LockMutex(stateMutex);
+    while (true) {
+        if (isStop || isPause || serial != videoQueue.serial()) {
+            ret = false;
+            break;
+        }
+
+        qint64 remaining = target - av_gettime_relative();
+        if (remaining < 1000) {
+            break;
+        }
+
+        SDL_CondWaitTimeout(stateCond, stateMutex, remaining / 1000);
+    }
+    SDL_UnlockMutex(stateMutex);
+
+    if (ret) {
+        qint64 remaining = target - av_gettime_relative();
+        if (remaining > 0) {
+            av_usleep(remaining);
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief 对解码出的一帧做音视频同步、滤镜转换并送往界面显示（显示线程）
+ * @param frame  解码器输出的原始帧，函数返回时已被 unref
+ * @param serial 帧所属的播放序列号
+ * @return true 帧已交给界面；false 帧因过时、迟到或转换失败被丢弃
+ */
+bool MainDecoder::renderFrame(AVFrame *frame, int serial, qint64 queuedAt)
+{
+    double framePts;
+
+    // 解码线程已把时间戳设为 best_effort_timestamp；仍然没有时间戳时紧接上一帧显示
+    if (frame->pts == AV_NOPTS_VALUE) {
+        framePts = frameTimer == 0 ? 0 : lastFramePts + lastFrameDuration;
+    } else {
+        framePts = frame->pts * av_q2d(frameTimeBase);
+    }
+
+    ClockType clockType = getMasterClockType();
+
+    /// 音视频同步:关键
+    // 这一帧的目标显示时刻 = 上一帧的目标显示时刻 + 显示间隔，间隔中已经包含了对主时钟偏差的修正
+    double delay = frameDelay(framePts, clockType);
+    qint64 now = av_gettime_relative();
+
+    if (frameTimer == 0) {
+        frameTimer = now;
+    } else {
+        frameTimer += static_cast<qint64>(delay * AV_TIME_BASE);
+        // 远远落后于计划（暂停恢复、解码卡顿），不再追赶之前的计划，从当前时刻重新计时
+        if (now - frameTimer > SYNC_RESET_THRESHOLD) {
+            frameTimer = now;
+        }
+    }
+
+    lastFramePts        = framePts;
+    lastFrameDuration   = frameDuration(frame);
+
+    // 只休眠一次直到目标时刻，不再以固定步长轮询主时钟；全速运行时不等待
+    bool isWaited   = false;
+    bool isSynced   = false;    // 是否按计划到达了显示时刻（没有被暂停、停止、跳转打断）
+    if (!isFreeRun) {
+        isWaited = frameTimer > now;
+        TRACE_BEGIN("wait_display");
+        isSynced = waitUntil(frameTimer, serial);
+        TRACE_END("wait_display");
+    }
 
-    AVFilterInOut *out = avfilter_inout_alloc();
-    AVFilterInOut *in = avfilter_inout_alloc();
-    // 输出格式为RGB32
-    enum AVPixelFormat pixFmts[] = {AV_PIX_FMT_RGB32, AV_PIX_FMT_NONE};     // AV_PIX_FMT_NONE 类似字符串里的\0，结束变量
-
-    // 释放上一个graph
-    if (filterGraph) {
-        avfilter_graph_free(&filterGraph);
-    }
-    // 分配新的graph
-    filterGraph = avfilter_graph_alloc();
-
-    /* 处理滤镜
-     * hb	Horizontal Deblocking	水平去块滤镜。消除水平方向上的块状效应（马赛克）。
-     * vb	Vertical Deblocking     垂直去块滤镜。消除垂直方向上的块状效应。
-     * dr	Deringing               去环效应。消除物体边缘常见的“重影”或“振铃”噪点。
-     * al	Autolevels              自动亮度/对比度。自动拉伸亮度范围，使画面层次感更强。
-     */
-    QString filter("pp=hb/vb/dr/al");
-
-    /* 输入格式参数
-     * video_size   width x height      视频的分辨率。滤镜需要知道画幅大小来分配内存或计算缩放。
-     * pix_fmt      pCodecCtx->pix_fmt	像素格式（如 YUV420P, NV12）。这是滤镜最关心的，决定了数据如何排列。
-     * time_base	num / den           时间基准。用于将帧的 pts (时间戳) 转换为实际秒数，对时间相关的滤镜（如 fps 或 setpts）至关重要。
-     * pixel_aspect	num / den           采样长宽比 (SAR)。告诉滤镜像素是正方形还是长方形，防止画面被拉伸变形。
-     */
-    QString args = QString("video_size=%1x%2:pix_fmt=%3:time_base=%4/%5:pixel_aspect=%6/%7")
-            .arg(pCodecCtx->width).arg(pCodecCtx->height).arg(av_get_pix_fmt_name(pCodecCtx->pix_fmt))
-            .arg(videoStream->time_base.num).arg(videoStream->time_base.den)
-            .arg(pCodecCtx->sample_aspect_ratio.num).arg(pCodecCtx->sample_aspect_ratio.den);
-
-    // 创建源滤镜（输入滤镜），接收原始帧
-    ret = avfilter_graph_create_filter(&filterSrcCxt, avfilter_get_by_name("buffer"), "in", args.toLocal8Bit().data(), NULL, filterGraph);
-    if (ret < 0) {
-        qDebug() << "avfilter graph create filter failed, ret:" << ret;
-        avfilter_graph_free(&filterGraph);
-        goto out;
+    // 等待期间发生了跳转，这一帧已经过时，不再滤镜和显示
+    if (serial != videoQueue.serial()) {
+        av_frame_unref(frame);
+        return false;
     }
 
-    // 创建汇滤镜（输出滤镜），输出处理后的帧
-    ret = avfilter_graph_create_filter(&filterSinkCxt, avfilter_get_by_name("buffersink"), "out", NULL, NULL, filterGraph);
-    if (ret < 0) {
-        qDebug() << "avfilter graph create filter failed, ret:" << ret;
-        avfilter_graph_free(&filterGraph);
-        goto out;
+    // 统计实际唤醒时刻与目标时刻的偏差，衡量显示节奏的抖动
+    if (isSynced && isWaited) {
+        jitterSum += qAbs(av_gettime_relative() - frameTimer);
+        jitterCount++;
     }
 
-    // 设置汇滤镜的输出格式为RGB32（显示传入 AV_PIX_FMT_NONE 结束变量）
-    ret = av_opt_set_int_list(filterSinkCxt, "pix_fmts", pixFmts, AV_PIX_FMT_NONE, AV_OPT_SEARCH_CHILDREN);
-    if (ret < 0) {
-        qDebug() << "av opt set int list failed, ret:" << ret;
-        avfilter_graph_free(&filterGraph);
-        goto out;
-    }
-    // 源滤镜是缓冲区的输出，是滤镜链的输入
-    out->name       = av_strdup("in");
-    out->filter_ctx = filterSrcCxt;
-    out->pad_idx    = 0;
-    out->next       = NULL;
-    // 汇滤镜是缓冲区的输入，是滤镜链的输出
-    in->name       = av_strdup("out");
-    in->filter_ctx = filterSinkCxt;
-    in->pad_idx    = 0;
-    in->next       = NULL;
-
-    if (filter.isEmpty() || filter.isNull()) {
-        // 如果没有指定滤镜字符串，直接把源和汇连起来
-        ret = avfilter_link(filterSrcCxt, 0, filterSinkCxt, 0);
-        if (ret < 0) {
-            qDebug() << "avfilter link failed, ret:" << ret;
-            avfilter_graph_free(&filterGraph);
-            goto out;
-        }
+    // 视频时钟从这一帧开始走时
+    videoClock.set(framePts);
+
+    // 这一帧的显示时间已经落后主时钟太多，跳过滤镜、转换和拷贝，帮助视频追上主时钟；
+    // 以视频时钟为主时钟时视频不会落后于自己，不丢帧。
+    // 跳转后还没有帧显示时不判断：快速跳转落在目标之前的关键帧上，而音频时钟在新序列的数据开始播放之前
+    // 一直停在跳转目标，按它计算会把关键帧及之后的一串帧都当作迟到丢掉。
+    // 拖动预览同样不丢：预览丢弃音频包，音频时钟一直停在拖动目标，关键帧几乎总是早于目标
+    bool isClockValid = clockType != AUDIO_CLOCK || audioDecoder->isClockRunning();
+    bool isPreview = isScrubbing || previewSerial >= 0;
+    if (isSynced && clockType != VIDEO_CLOCK && !isSeekPending && !isPreview && isClockValid
+            && dropLateFrame(getMasterClock() - framePts)) {
+        av_frame_unref(frame);
+        return false;
+    }
+
+    // 缩放到窗口大小并将 YUV 格式转换为 RGB 格式（滤镜链已在解码线程中处理）
+    qint64 convertStart = av_gettime_relative();
+    TRACE_BEGIN("convert");
+    bool isConverted = convertFrame(frame, frameTimeBase);
+    TRACE_END("convert");
+    convertCounter.add(av_gettime_relative() - convertStart);
+
+    if (!isConverted) {
+        return false;
     } else {
-        // 解析滤镜字符串，构建中间的滤镜链，连接 source -> filter -> sink
-        ret = avfilter_graph_parse_ptr(filterGraph, filter.toLatin1().data(), &in, &out, NULL);
-        if (ret < 0) {
-            qDebug() << "avfilter graph parse ptr failed, ret:" << ret;
-            avfilter_graph_free(&filterGraph);
-            goto out;
+        // 【新增安全锁】：拦截滤镜图在异常状态下吐出的畸形帧
+        if (frame->width <= 0 || frame->height <= 0 || frame->data[0] == nullptr) {
+            qDebug() << "Filter graph generated an invalid frame after seek. Dropping.";
+            av_frame_unref(frame);
+            return false;
         }
-    }
 
-    // 最终检查并配置整个滤镜图
-    if ((ret = avfilter_graph_config(filterGraph, NULL)) < 0) {
-        qDebug() << "avfilter graph config failed, ret:" << ret;
-        avfilter_graph_free(&filterGraph);
-    }
 
-out:
-    // 释放资源
-    avfilter_inout_free(&out);
-    avfilter_inout_free(&in);
+        // 把滤镜输出帧的引用转交给 QImage，不拷贝像素数据：
+        // 界面持有的最后一个 QImage 副本析构时才释放这一帧，缓冲区回到滤镜的缓冲池中复用
+        AVFrame *imageFrame = av_frame_alloc();
+        av_frame_move_ref(imageFrame, frame);
+
+        // 使用 frame 中的数据（data[0] 指向像素数组）构造一个 Qt 的 QImage 对象。
+        // 这里假设滤镜已经转成了 RGB32 格式，大小为宽 x 高。
+        // 以只读方式引用，界面若要修改图像会先自动拷贝，不会写坏缓冲池中的数据。
+        // 转换结果不透明（alpha 为 0xff），直接按预乘格式使用，绘制时是简单的内存拷贝
+        // 【修复核心】：使用 frame 的真实宽高，并且强行绑定 linesize[0] 内存步长
+        QImage image(static_cast<const uchar *>(imageFrame->data[0]),
+                     imageFrame->width,         // 弃用 pCodecCtx->width
+                     imageFrame->height,        // 弃用 pCodecCtx->height
+                     imageFrame->linesize[0],   // 这是最关键的内存对齐参数！
+                     QImage::Format_ARGB32_Premultiplied,
+                     &MainDecoder::releaseImageFrame,
+                     imageFrame);
+
+        if (image.isNull()) {
+            // 如果走到这里，说明这帧的内存确实坏了，静默丢弃，保护主线程不崩溃
+            qDebug() << "QImage creation failed. Memory might be misaligned.";
+            av_frame_free(&imageFrame);
+            return false;
+        } else {
+            // 统计送显时刻的音视频偏差，衡量同步精度
+            if (clockType == AUDIO_CLOCK) {
+                syncErrorSum += qAbs(audioDecoder->getAudioClock() - framePts);
+                syncErrorCount++;
+            }
 
-    return ret;
-}
+            displayVideo(image);
+            TRACE_COUNTER("frame_queue_frames", frameQueue.queueSize());
 
-// 开始解码线程
-void MainDecoder::decoderFile(QString file, QString type)
-{
-    // 先暂停旧线程
-    qDebug() << "File name:" << file << ", type:" << type;
-    if (playState != STOP) {
-        isStop = true;
-        while (playState != STOP) {
-            SDL_Delay(10);
+            videoFramesPresented.fetchAndAddOrdered(1);
+            if (latencyRecording) {
+                SDL_LockMutex(latencyMutex);
+                frameLatencies.append(av_gettime_relative() - queuedAt);
+                SDL_UnlockMutex(latencyMutex);
+            }
         }
-        SDL_Delay(100);
     }
-    // 重置数据
-    clearData();
-
-    SDL_Delay(100);
 
-    currentFile = file;
-    currentType = type;
-    // 开始新线程
-    this->start();
+    return true;
 }
 
-// 音频解码线程通知音频播放完成
-void MainDecoder::audioFinished()
+// 界面显示的 QImage 最后一个副本析构时调用（可能在任意线程），释放其引用的帧
+void MainDecoder::releaseImageFrame(void *info)
 {
-    // 音频播放完成
-    isStop = true;
-    if (currentType == "music") {
-        // 如果播放的是音频则直接将状态变为finish
-        SDL_Delay(100);
-        // 通知主线程播放完成
-        emit playStateChanged(MainDecoder::FINISH);
-    }
+    AVFrame *frame = static_cast<AVFrame *>(info);
+
+    av_frame_free(&frame);
 }
 
-// 主线程通知停止播放
-void MainDecoder::stopVideo()
+/**
+ * @brief 根据帧的迟到时长决定是否丢弃，并按连续迟到情况调整解码器跳帧级别（显示线程）
+ * @param lateness 帧落后音频时钟的时长（秒），负数表示未迟到
+ * @return true 丢弃这一帧
+ */
+bool MainDecoder::dropLateFrame(double lateness)
 {
-    if (playState == STOP) {
-        // 如果已经为停止状态则再去通知主线程设置stop状态
-        setPlayState(MainDecoder::STOP);
-        return;
-    }
+    qint64 now = av_gettime_relative();
 
-    // gotstop代表主线程主动结束，等待解码线程退出循环后设置为stop
-    gotStop = true;
-    isStop  = true;
-    // 通知音频解码线程停止解码
-    audioDecoder->stopAudio();
+    if (lateness <= LATE_FRAME_THRESHOLD) {
+        lateStreak = 0;
 
-    if (currentType == "video") {
-        // 视频模式：必须等待“读取”和“解码”两个动作都停稳
-        while (!isReadFinished || !isDecodeFinished) {
-            SDL_Delay(10);
-        }
-    } else {
-        // 音乐模式：只需要等“读取”动作停稳
-        while (!isReadFinished) {
-            SDL_Delay(10);
+        // 一段时间没有迟到帧，说明负载已经下降，逐级恢复解码
+        int level = skipLevel;
+        if (level > 0 && now - lastLateTime > SKIP_RECOVER_TIME && now - skipLevelChangedAt > SKIP_RECOVER_TIME) {
+            skipLevel = level - 1;
+            skipLevelChangedAt = now;
+            qDebug() << "Video skip level decreased to" << level - 1;
         }
+
+        return false;
     }
-}
 
-// 主线程通知暂停或回复播放
-void MainDecoder::pauseVideo()
-{
-    qDebug() << "leftbutton.Decoder::pauseVideo()";
-    if (playState == STOP) {
-        qDebug() << "leftbutton.Decoder::pauseVideo()...stop";
-        return;
+    lastLateTime = now;
+
+    // 连续丢了太多帧时显示一帧，保证过载时画面仍然在更新
+    if (lateStreak >= LATE_FRAME_MAX_CONSECUTIVE) {
+        lateStreak = 0;
+        return false;
     }
 
-    isPause = !isPause;
-    // 通知音频解码线程暂停或者恢复播放
-    audioDecoder->pauseAudio(isPause);
-    if (isPause) {
-        // 通知数据源暂停
-        av_read_pause(pFormatCtx);
-        // 改变本线程状态
-        setPlayState(PAUSE);
-    } else {
-        // 通知数据源继续
-        av_read_play(pFormatCtx);
-        // 改变本线程状态
-        setPlayState(PLAYING);
+    lateStreak++;
+    lateFramesDropped.fetchAndAddOrdered(1);
+
+    // 只丢显示还追不上：让解码器少解一些帧
+    int level = skipLevel;
+    if (lateStreak >= SKIP_ESCALATE_STREAK && level < SKIP_LEVEL_MAX && now - skipLevelChangedAt > SKIP_ESCALATE_INTERVAL) {
+        skipLevel = level + 1;
+        skipLevelChangedAt = now;
+        qDebug() << "Video is late by" << lateness << "s, skip level increased to" << level + 1;
     }
+
+    return true;
 }
 
-// 主线程获取音量
-int MainDecoder::getVolume()
+// 重置迟到帧状态，开始播放或跳转后的新序列不沿用之前的跳帧级别（显示线程）
+void MainDecoder::resetFrameDropping()
 {
-    return audioDecoder->getVolume();
+    skipLevel           = 0;
+    lateStreak          = 0;
+    lastLateTime        = 0;
+    skipLevelChangedAt  = 0;
 }
 
-// 主线程设置音量
-void MainDecoder::setVolume(int volume)
+// 把显示线程设置的跳帧级别应用到解码器（解码线程，送入数据包之前调用）
+void MainDecoder::applySkipLevel()
 {
-    audioDecoder->setVolume(volume);
+    static const AVDiscard discards[SKIP_LEVEL_MAX + 1] = {
+        AVDISCARD_DEFAULT,  // 全部解码
+        AVDISCARD_NONREF,   // 跳过不被其他帧参考的帧（如 B 帧），不影响后续帧的解码
+        AVDISCARD_NONKEY    // 只解码关键帧
+    };
+
+    // 拖动预览时只解码关键帧
+    int level = isScrubbing ? SKIP_LEVEL_MAX : static_cast<int>(skipLevel);
+    if (level != appliedSkipLevel) {
+        pCodecCtx->skip_frame = discards[level];
+        appliedSkipLevel = level;
+    }
 }
 
-// 主线程获取当前时间（音频作为主时钟）
-double MainDecoder::getCurrentTime()
+// 取出解码器中所有已就绪的帧送入帧队列，跳转或停止时不再继续；返回在解码器中花费的时间（微秒，不含等待帧队列）
+qint64 MainDecoder::receiveFrames(AVFrame *frame)
 {
-    if (audioIndex >= 0) {
-        return audioDecoder->getAudioClock();
+    int ret;
+    qint64 decodeTime = 0;
+
+    while (!isStop && videoSerial == videoQueue.serial()) {
+        qint64 start = av_gettime_relative();
+        ret = avcodec_receive_frame(pCodecCtx, frame);
+        decodeTime += av_gettime_relative() - start;
+
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            // 需要更多数据或已经冲刷完毕，这是正常现象，不需要打印日志
+            break;
+        } else if (ret < 0) {
+            // 只有走到这里，才是真正的解码失败（比如码流损坏）
+            qDebug() << "Video frame decode failed, error code:" << ret;
+            break;
+        }
+
+        videoFramesDecoded.fetchAndAddOrdered(1);
+
+        // 使用解码器推测的最佳时间戳，B 帧重排或 pts 缺失时比包的 pts 可靠
+        frame->pts = frame->best_effort_timestamp;
+
+        // 精确跳转：目标之前的帧解码后直接丢弃，不经过滤镜转换和显示
+        if (discardBeforeTarget(frame)) {
+            av_frame_unref(frame);
+            continue;
+        }
+
+        // 经过滤镜链后送入帧队列，队列已满时阻塞，直到显示线程取走一帧；被 abort 说明已停止
+        if (!queueFrame(frame)) {
+            break;
+        }
     }
 
-    return 0;
+    return decodeTime;
 }
 
-// 主线程跳转请求拦截
-void MainDecoder::seekProgress(qint64 pos)
+/**
+ * @brief 精确跳转时判断解码出的帧是否在目标之前（解码线程）
+ * @note  帧的结束时间不晚于目标即丢弃；遇到第一个到达目标的帧、或丢弃数超过上限后本序列不再判断
+ */
+bool MainDecoder::discardBeforeTarget(AVFrame *frame)
 {
-    if (!isSeek) {
-        seekPos = pos;
-        isSeek = true;
+    if (discardTarget == AV_NOPTS_VALUE) {
+        return false;
     }
-}
 
+    if (frame->pts != AV_NOPTS_VALUE && discardedFrames < ACCURATE_SEEK_MAX_FRAMES) {
+        qint64 start = av_rescale_q(frame->pts, videoStream->time_base, av_get_time_base_q());
+        qint64 duration = 0;
 
-double MainDecoder::synchronize(AVFrame *frame, double pts)
-{
-    double delay;
-    if (pts != 0) {
-        videoClk = pts; // 如果当前帧自带 PTS，则用它更新视频时钟
-    } else {
-        pts = videoClk; // 如果当前帧没有 PTS，则沿用上一次计算出的视频时钟
-    }
+        // 帧时长：优先使用包携带的时长，否则按流的帧率推算
+        if (frame->pkt_duration > 0) {
+            duration = av_rescale_q(frame->pkt_duration, videoStream->time_base, av_get_time_base_q());
+        } else {
+            AVRational frameRate = av_guess_frame_rate(pFormatCtx, videoStream, NULL);
+            if (frameRate.num && frameRate.den) {
+                duration = av_rescale_q(1, av_inv_q(frameRate), av_get_time_base_q());
+            }
+        }
 
-    // 使用时间基预测下次时间戳
-    delay = av_q2d(pCodecCtx->time_base);
-    delay += frame->repeat_pict * (delay * 0.5);
+        if (start + duration <= discardTarget) {
+            discardedFrames++;
+            return true;
+        }
+    } else if (discardedFrames >= ACCURATE_SEEK_MAX_FRAMES) {
+        qDebug() << "Accurate seek gave up after" << discardedFrames << "frames";
+    }
 
-    videoClk += delay;
+    lastSeekDiscarded   = discardedFrames;
+    discardTarget       = AV_NOPTS_VALUE;
 
-    return pts;
+    return false;
 }
 
 int MainDecoder::videoThread(void *arg)
 {
     int ret;
-    double pts;
+    int serial;
     AVPacket packet;
     // 将this指针强转为MainDecoder来访问类的公有变量
     MainDecoder *decoder = (MainDecoder *)arg;
     AVFrame *pFrame  = av_frame_alloc();
 
+    TRACE_THREAD_NAME("video_decode");
+
+    // 暂停时不等待：继续解码直到帧队列填满，恢复播放后立即有帧可以显示
     while (true) {
         if (decoder->isStop) {
             break;
         }
 
-        if (decoder->isPause) {
-            SDL_Delay(10);
-            continue;
-        }
-
-        if (decoder->videoQueue.queueSize() <= 0) {
-            // 如果队列是空的，且 isReadFinished 标志为真（表示文件读取线程已经读完了所有数据）
+        // 从视频队列中取出一个数据包（Packet）存入 packet 变量中，队列为空时阻塞等待
+        if (!decoder->videoQueue.dequeue(&packet, true, &serial)) {
+            // 队列已空且被 abort：停止播放，或者文件已经读完（isReadFinished）且数据已全部解码
             // 说明视频已经播放完了，跳出主循环，结束线程
-            if (decoder->isReadFinished) {
+            if (decoder->isStop || decoder->isReadFinished) {
                 break;
             }
-            // 如果队列为空但文件还没读完（数据还没送来），让线程休眠 1 毫秒，防止空转消耗 CPU
-            // 跳过本次循环，回到开头等待数据到来
-            SDL_Delay(1);
             continue;
         }
 
-        // 从视频队列中取出一个数据包（Packet）存入 packet 变量中。参数 true 通常表示这是一个阻塞操作
-        decoder->videoQueue.dequeue(&packet, true);
+        // 序列号与队列当前序列号不同，说明是跳转（Seek）之前读入的旧包，直接丢弃不解码
+        if (serial != decoder->videoQueue.serial()) {
+            av_packet_unref(&packet);
+            continue;
+        }
 
-        // 检查取出的包的数据内容是不是字符串 "FLUSH"。这通常是自定义的特殊包，用于在用户**拖动进度条（Seek）**时清空缓存。
-        if (packet.size == 5 && memcmp(packet.data, "FLUSH", 5) == 0) {
+        // 新播放序列的第一个包：清空一次解码器，滤镜链在下一帧时重建，丢弃其中缓存的旧帧
+        if (serial != decoder->videoSerial) {
             qDebug() << "Seek video";
             // 调用 FFmpeg API 清空解码器上下文中的内部缓存。这是 Seek 操作必须的，否则画面会花屏。
             avcodec_flush_buffers(decoder->pCodecCtx);
 
-            // 2. 【新增】：抽干滤镜图（FilterGraph）里残留的旧帧，防止画面错乱
-            AVFrame *dummyFrame = av_frame_alloc();
-            while (av_buffersink_get_frame(decoder->filterSinkCxt, dummyFrame) >= 0) {
-                av_frame_unref(dummyFrame);
-            }
-            av_frame_free(&dummyFrame);
-            av_packet_unref(&packet);
-            continue;
+            decoder->videoSerial = serial;
+            decoder->isFilterInited = false;
+
+            // 本序列的精确跳转目标，doSeek() 在序列号加一之前设置
+            decoder->discardTarget      = decoder->seekTarget.loadAcquire();
+            decoder->discardedFrames    = 0;
+        }
+
+        // 滤镜配置改变：下一帧时重建滤镜链，解码器和文件保持不变
+        if (decoder->filterChanged.testAndSetOrdered(1, 0) && decoder->currentVideoFilter() != decoder->activeFilter) {
+            qDebug() << "Video filter changed to" << decoder->currentVideoFilter();
+            decoder->isFilterInited = false;
         }
 
+        decoder->applySkipLevel();
+
+        TRACE_SCOPE("decode_packet");
+        qint64 start = av_gettime_relative();
         ret = avcodec_send_packet(decoder->pCodecCtx, &packet);
-        // 检查返回值。如果返回值小于0，且错误不是“需要更多数据(EAGAIN)”或“文件结束(EOF)”，则表示发生了真正的错误
-        if ((ret < 0) && (ret != AVERROR(EAGAIN)) && (ret != AVERROR_EOF)) {
+        qint64 decodeTime = av_gettime_relative() - start;
+        av_packet_unref(&packet);
+        // 每次送入后都会把解码器中的帧全部取出，所以这里不会出现 EAGAIN
+        if ((ret < 0) && (ret != AVERROR_EOF)) {
             qDebug() << "Video send to decoder failed, error code: " << ret;
-            av_packet_unref(&packet);
             continue;
         }
 
-        /// raw yuv
-        ret = avcodec_receive_frame(decoder->pCodecCtx, pFrame);
-        if (ret == AVERROR(EAGAIN)) {
-            // 这是正常现象，不需要打印日志
-            // 直接释放当前 packet 并继续读取下一个 packet 即可
-            av_packet_unref(&packet);
-            continue;
-        } else if (ret == AVERROR_EOF) {
-            // 视频结束了
-            return 0;
-        } else if (ret < 0) {
-            // 只有走到这里，才是真正的解码失败（比如码流损坏）
-            qDebug() << "Video frame decode failed, error code:" << ret;
-            av_packet_unref(&packet);
-            continue;
-        }
+        decoder->videoPacketsSent.fetchAndAddOrdered(1);
 
-        // 获取当前帧的显示时间戳 pts。如果该帧没有标记时间戳（等于 AV_NOPTS_VALUE）
-        // 将 pts 强制置为 0，防止无效值参与计算
-        if ((pts = pFrame->pts) == AV_NOPTS_VALUE) {
-            pts = 0;
+        /* raw yuv
+         * 多线程解码时解码器内部有 thread_count - 1 帧的延迟：前几个包没有输出，之后一个包可能输出多帧，
+         * 所以每送入一个包都要循环取帧直到 EAGAIN，否则帧会积压在解码器里越来越晚
+         */
+        decodeTime += decoder->receiveFrames(pFrame);
+
+        // 拖动预览：冲刷解码器，关键帧不等多线程解码的延迟立即输出，之后重新开始
+        if (decoder->isScrubbing) {
+            avcodec_send_packet(decoder->pCodecCtx, NULL);
+            decodeTime += decoder->receiveFrames(pFrame);
+            avcodec_flush_buffers(decoder->pCodecCtx);
         }
 
-        /// 音视频同步:关键
-        pts *= av_q2d(decoder->videoStream->time_base);
-        pts =  decoder->synchronize(pFrame, pts);
+        decoder->decodeCounter.add(decodeTime);
+    }
+
+    // 文件读完：送入空包冲刷解码器，取出多线程解码延迟在解码器内部的最后几帧
+    if (!decoder->isStop && decoder->videoSerial == decoder->videoQueue.serial()) {
+        avcodec_send_packet(decoder->pCodecCtx, NULL);
+        decoder->receiveFrames(pFrame);
+        decoder->flushFilter();
+    }
 
-        // 判断是否存在音频流（audioIndex >= 0）。
-        // 只有有音频时，才需要视频去追音频
-        if (decoder->audioIndex >= 0) {
-            // 视频同步音频循环
-            while (1) {
-                if (decoder->isStop || decoder->isPause) {
-                    break;
-                }
+    av_frame_free(&pFrame);
 
-                // 获取当前音频播放到的时间点（秒），作为同步的基准时钟。
-                double audioClk = decoder->audioDecoder->getAudioClock();
+    // 不再有新帧：显示线程取完队列中剩余的帧后退出
+    decoder->frameQueue.abort();
 
-                // // 用预测的下一帧视频和音频同步
-                pts = decoder->videoClk;
+    qDebug() << "Video decoder finished.";
 
-                // 若视频时间戳等于音频时间戳则退出同步循环，立即渲染此帧画面
-                if (pts <= audioClk) {
-                     break;
-                }
+    return 0;
+}
 
-                // 如果视频快了（pts > audioClk），计算两者的时间差，并转换为毫秒
-                int delayTime = (pts - audioClk) * 1000;
+/**
+ * @brief 视频显示线程：从帧队列取帧，只负责同步等待、滤镜转换和送往界面
+ * @note  解码耗时的抖动被帧队列吸收，不会推迟已解码帧的显示
+ */
+int MainDecoder::presentThread(void *arg)
+{
+    int serial;
+    qint64 queuedAt;
+    bool isFirstFrame;
+    AVRational timeBase;
+    MainDecoder *decoder = (MainDecoder *)arg;
+    AVFrame *pFrame  = av_frame_alloc();
 
-                // 限制最大休眠时间为 5 毫秒。这是为了防止休眠太久导致无法响应操作，采用“小步快跑”的策略
-                delayTime = delayTime > 5 ? 5 : delayTime;
+    TRACE_THREAD_NAME("video_present");
 
-                SDL_Delay(delayTime);
-            }
+    while (true) {
+        if (decoder->isStop) {
+            break;
         }
 
-        // 将解码出来的原始帧 pFrame 添加到滤镜图的输入端（filterSrcCxt）。
-        // 这个滤镜图通常用于将 YUV 格式转换为 RGB 格式
-        if (av_buffersrc_add_frame(decoder->filterSrcCxt, pFrame) < 0) {
-            qDebug() << "av buffersrc add frame failed.";
-            av_packet_unref(&packet);
+        if (decoder->isPause && decoder->previewSerial < 0) {
+            // 暂停时阻塞等待恢复或停止；暂停中跳转时仍显示新位置的第一帧
+            decoder->waitForResume();
             continue;
         }
 
-        // 从滤镜图的输出端（filterSinkCxt）获取处理好（已转为 RGB）的帧，覆盖写入 pFrame
-        if (av_buffersink_get_frame(decoder->filterSinkCxt, pFrame) < 0) {
-            qDebug() << "av buffersrc get frame failed.";
-            av_packet_unref(&packet);
+        // 帧队列为空且被 abort：停止播放，或者解码线程已经结束且所有帧都已显示
+        if (!decoder->frameQueue.pop(pFrame, &serial, true, &queuedAt, &timeBase)) {
+            break;
+        }
+
+        // 跳转之前解码出的旧帧，直接丢弃
+        if (serial != decoder->videoQueue.serial()) {
+            av_frame_unref(pFrame);
             continue;
-        } else {
-            // 【新增安全锁】：拦截滤镜图在异常状态下吐出的畸形帧
-            if (pFrame->width <= 0 || pFrame->height <= 0 || pFrame->data[0] == nullptr) {
-                qDebug() << "Filter graph generated an invalid frame after seek. Dropping.";
-                av_frame_unref(pFrame);
-                av_packet_unref(&packet);
-                continue;
-            }
+        }
+
+        // 经过滤镜链的帧使用滤镜链输出的时间基
+        decoder->frameTimeBase = timeBase;
+
+        // 窗口大小或长宽比模式改变：只重建输出级，滤镜链保持不变
+        if (decoder->displayChanged.testAndSetOrdered(1, 0)) {
+            decoder->freeFilterStage(&decoder->outputStage);
+        }
+
+        // 新播放序列的第一帧
+        isFirstFrame = serial != decoder->presentSerial;
+        if (isFirstFrame) {
+            decoder->presentSerial = serial;
 
+            // 从这一帧开始重新计时
+            decoder->frameTimer = 0;
 
-            // 使用 pFrame 中的数据（data[0] 指向像素数组）构造一个 Qt 的 QImage 对象。
-            // 这里假设滤镜已经转成了 RGB32 格式，大小为宽 x 高。
-            // 注意这里没有发生数据拷贝，只是引用。
-            // 【修复核心】：使用 pFrame 的真实宽高，并且强行绑定 linesize[0] 内存步长
-            QImage tmpImage(pFrame->data[0],
-                            pFrame->width,       // 弃用 decoder->pCodecCtx->width
-                            pFrame->height,      // 弃用 decoder->pCodecCtx->height
-                            pFrame->linesize[0], // 这是最关键的内存对齐参数！
-                            QImage::Format_RGB32);
-
-            if (tmpImage.isNull()) {
-                // 如果走到这里，说明这帧的内存确实坏了，静默丢弃，保护主线程不崩溃
-                qDebug() << "QImage creation failed. Memory might be misaligned.";
-            } else {
-                QImage image = tmpImage.copy();
-                decoder->displayVideo(image);
+            // 跳转到关键帧后第一帧的时间戳可能早于跳转目标，视频/外部时钟从这一帧开始走时
+            double firstPts = pFrame->pts == AV_NOPTS_VALUE ? 0 :
+                              pFrame->pts * av_q2d(timeBase);
+            decoder->videoClock.set(firstPts);
+            if (decoder->getMasterClockType() == EXTERNAL_CLOCK) {
+                decoder->externalClock.set(firstPts);
             }
+
+            // 跳转后重新评估负载
+            decoder->resetFrameDropping();
+
+            decoder->isSeekPending = true;
         }
 
-        av_frame_unref(pFrame);
-        av_packet_unref(&packet);
+        // 跳转后第一个真正交给界面的帧（第一帧不按迟到丢弃，但可能因跳转过时或转换失败被丢弃）：结束跳转，暂停中不再继续显示
+        if (decoder->renderFrame(pFrame, serial, queuedAt) && decoder->isSeekPending) {
+            decoder->isSeekPending = false;
+            decoder->previewSerial.testAndSetOrdered(serial, -1);
+            decoder->finishSeek();
+        }
     }
 
     av_frame_free(&pFrame);
 
+    qDebug() << "Video presenter finished.";
+
+    // 如果是主线程通知结束，由解复用线程在回收本线程后设置 stop，否则为 finish
     if (!decoder->isStop) {
-        decoder->isStop = true;
+        decoder->finishPlay();
     }
 
-    qDebug() << "Video decoder finished.";
+    return 0;
+}
 
-    SDL_Delay(100);
 
-    // 解码完成
-    decoder->isDecodeFinished = true;
+/**
+ * @brief 解复用线程：常驻运行，按顺序处理控制命令
+ * @note  界面线程的槽函数只投递命令后立即返回，停止、切换文件都在这里完成，不会卡住界面
+ */
+void MainDecoder::run()
+{
+    Command cmd;
 
-    // 如果是主线程通知结束则是stop否则为finish
-    if (decoder->gotStop) {
-        decoder->setPlayState(MainDecoder::STOP);
-    } else {
-        decoder->setPlayState(MainDecoder::FINISH);
+    TRACE_THREAD_NAME("demux");
+
+    while (takeCommand(&cmd)) {
+        switch (cmd.type) {
+        case CMD_OPEN:
+            // 播放直到收到停止/打开/退出命令，这些命令留在队列中由下一轮循环处理
+            playFile(cmd);
+            break;
+
+        case CMD_STOP:
+            // 通知主线程设置stop状态（已经停止时也通知，与原有行为一致）
+            setPlayState(MainDecoder::STOP);
+            break;
+
+        case CMD_QUIT:
+            return;
+
+        default:
+            // 没有播放时忽略暂停和跳转
+            break;
+        }
     }
+}
 
-    return 0;
+/**
+ * @brief 跳转后的第一帧已显示（显示线程）：统计从发出跳转命令到显示的延迟
+ * @note  打开文件后的第一帧没有对应的跳转命令，不统计
+ */
+void MainDecoder::finishSeek()
+{
+    qint64 issuedAt = seekIssuedAt.fetchAndStoreOrdered(0);
+
+    if (issuedAt == 0) {
+        return;
+    }
+
+    qint64 latency = av_gettime_relative() - issuedAt;
+    lastSeekLatency = latency;
+
+    qDebug() << "Seek latency:" << latency / 1000.0 << "ms," << (seekTarget != AV_NOPTS_VALUE ? "accurate" : "fast")
+             << "mode, discarded" << lastSeekDiscarded << "frames";
+
+    emit seekFinished(latency);
 }
 
+/**
+ * @brief 执行跳转操作（解复用线程）
+ * @param pos      目标位置（微秒），可以不是整秒
+ * @param issuedAt 跳转命令发出的时刻，用于统计跳转延迟
+ * @param isScrub  拖动预览，只解码关键帧
+ */
+void MainDecoder::doSeek(qint64 pos, qint64 issuedAt, bool isScrub)
+{
+    int seekIndex;          // 跳转的流索引
+    qint64 seekPos;
+    qint64 keyPts, keyPos;  // 关键帧索引中目标之前最近的关键帧
+    bool isSeeked = false;
+
+    TRACE_SCOPE("seek");
 
-void MainDecoder::run()
+    if (currentType == "video") {
+        seekIndex = videoIndex;
+    } else {
+        seekIndex = audioIndex;
+    }
+
+    // 获取FFmpeg 内部时间基准(通常是 1/1000000)
+    AVRational aVRational = av_get_time_base_q();
+    // 将显示时间转换为视频内部刻度
+    seekPos = av_rescale_q(pos, aVRational, pFormatCtx->streams[seekIndex]->time_base);
+
+
+    // 执行跳转
+    // AVSEEK_FLAG_BACKWARD：这是一个非常稳妥的标志。它的意思是：如果 seekPos 处没有关键帧，就往**回（前）**找最近的一个 I 帧。
+    // 这样能保证跳转后画面能立即正常显示，而不是花屏。
+
+
+    // 有关键帧索引时直接按字节定位到关键帧，不依赖容器的索引质量
+    if (currentType == "video" && keyframeIndex.lookup(pos, &keyPts, &keyPos)) {
+        isSeeked = av_seek_frame(pFormatCtx, -1, keyPos, AVSEEK_FLAG_BYTE) >= 0;
+        qDebug() << "Seek by keyframe index:" << keyPts / 1000 << "ms at byte" << keyPos << (isSeeked ? "" : "failed");
+    }
+
+    if (!isSeeked && av_seek_frame(pFormatCtx, seekIndex, seekPos, AVSEEK_FLAG_BACKWARD) < 0) {
+        qDebug() << "Seek failed.";
+        av_seek_frame(pFormatCtx, seekIndex, seekPos, AVSEEK_FLAG_ANY);
+    } else {
+        // 文件读完后队列已被 abort，跳转后重新开始阻塞等待
+        videoQueue.resume();
+        audioDecoder->getPacketQueue()->resume();
+        isReadFinished = false;
+
+        // 精确跳转时解码线程丢弃目标之前的数据，需在序列号加一之前设置，新序列的第一个包一定能看到
+        isScrubbing         = isScrub && currentType == "video";
+        seekTarget          = isAccurateSeek && !isScrubbing ? pos : AV_NOPTS_VALUE;
+        seekIssuedAt        = issuedAt;
+        lastSeekDiscarded   = 0;
+        audioDecoder->setSeekTarget(seekTarget);
+
+        // 清空音频解码缓存，开始新的播放序列
+        audioDecoder->emptyAudioData();
+
+        double targetTimeSec = seekPos * av_q2d(pFormatCtx->streams[seekIndex]->time_base);
+        audioDecoder->setClock(targetTimeSec);
+        videoClock.set(targetTimeSec);
+        externalClock.set(targetTimeSec);
+
+        if (currentType == "video") {
+            // 清空视频包队列，序列号加一，解码线程据此丢弃旧数据并清空解码器
+            videoQueue.flush();
+            // 丢弃已解码未显示的旧帧，同时唤醒可能阻塞在满队列上的解码线程
+            frameQueue.empty();
+            // 新位置的第一帧暂停时也要显示
+            previewSerial = videoQueue.serial();
+            // 唤醒正在等待显示时刻（或暂停中）的显示线程，不再等待旧帧
+            SDL_LockMutex(stateMutex);
+            SDL_CondBroadcast(stateCond);
+            SDL_UnlockMutex(stateMutex);
+        }
+    }
+}
+
+/**
+ * @brief 打开文件并循环读取数据包，直到收到停止/打开/退出命令，然后回收所有资源
+ * @param cmd CMD_OPEN 命令
+ */
+void MainDecoder::playFile(const Command &cmd)
 {
     AVCodec *pCodec;
 
     AVPacket pkt, *packet = &pkt;        // packet use in decoding
 
-    int seekIndex;          // 跳转的流索引
     bool realTime;
+    int ret;
+
+    qint64 openStart = av_gettime_relative();
+
+    // 重置数据
+    clearData();
+
+    currentFile = cmd.file;
+    currentType = cmd.fileType;
 
     pFormatCtx = avformat_alloc_context();
+    // 收到停止/打开命令时中断阻塞的 I/O（如网络流）
+    pFormatCtx->interrupt_callback.callback = &MainDecoder::interruptCallback;
+    pFormatCtx->interrupt_callback.opaque   = this;
+
+    // 本地文件由后台线程预读，解复用时不直接等待网络挂载盘或硬盘的 I/O
+    if (readAheadSize > 0 && ReadAheadIO::isUseful(currentFile)) {
+        pFormatCtx->pb = readAhead.open(currentFile, &pFormatCtx->interrupt_callback, readAheadSize);
+    }
 
     if (avformat_open_input(&pFormatCtx, currentFile.toLocal8Bit().data(), NULL, NULL) != 0) {
         qDebug() << "Open file failed.";
+        readAhead.close();
         return ;
     }
 
     if (avformat_find_stream_info(pFormatCtx, NULL) < 0) {
         qDebug() << "Could't find stream infomation.";
-        avformat_free_context(pFormatCtx);
+        avformat_close_input(&pFormatCtx);
+        readAhead.close();
         return;
     }
 
@@ -562,13 +1864,15 @@ void MainDecoder::run()
     if (currentType == "video") {
         if (videoIndex < 0) {
             qDebug() << "Not support this video file, videoIndex: " << videoIndex << ", audioIndex: " << audioIndex;
-            avformat_free_context(pFormatCtx);
+            avformat_close_input(&pFormatCtx);
+            readAhead.close();
             return;
         }
     } else {
         if (audioIndex < 0) {
             qDebug() << "Not support this audio file.";
-            avformat_free_context(pFormatCtx);
+            avformat_close_input(&pFormatCtx);
+            readAhead.close();
             return;
         }
     }
@@ -584,14 +1888,24 @@ void MainDecoder::run()
     if (audioIndex >= 0) {
         // 打开音频解码器：入口，注册回调函数
         if (audioDecoder->openAudio(pFormatCtx, audioIndex) < 0) {
-            avformat_free_context(pFormatCtx);
+            avformat_close_input(&pFormatCtx);
+            readAhead.close();
             return;
         }
     }
 
+    // 两个队列都在使用时相互关联，任一队列快被取空时不再因另一个队列已满而阻塞读取
+    if (currentType == "video" && audioIndex >= 0) {
+        videoQueue.setCompanion(audioDecoder->getPacketQueue());
+        audioDecoder->getPacketQueue()->setCompanion(&videoQueue);
+    } else {
+        videoQueue.setCompanion(nullptr);
+        audioDecoder->getPacketQueue()->setCompanion(nullptr);
+    }
+
     if (currentType == "video") {
         // 创建解码线程
-        /* find video decoder */        
+        /* find video decoder */
         pCodecCtx = avcodec_alloc_context3(NULL);
         avcodec_parameters_to_context(pCodecCtx, pFormatCtx->streams[videoIndex]->codecpar);
 
@@ -601,107 +1915,103 @@ void MainDecoder::run()
             goto fail;
         }
 
+        // 多线程解码，需在打开解码器之前设置
+        configureDecodeThreads(pCodecCtx, pCodec);
+
         // 打开视频解码器
         if (avcodec_open2(pCodecCtx, pCodec, NULL) < 0) {
             qDebug() << "Could not open video decoder.";
             goto fail;
         }
 
+        qDebug() << "Video decoder:" << pCodec->name << ", threads:" << pCodecCtx->thread_count
+                 << ", frame threading:" << bool(pCodecCtx->active_thread_type & FF_THREAD_FRAME)
+                 << ", slice threading:" << bool(pCodecCtx->active_thread_type & FF_THREAD_SLICE);
+
         videoStream = pFormatCtx->streams[videoIndex];
+        videoQueue.setTimeBase(videoStream->time_base);
 
-        if (initFilter() < 0) {
-            goto fail;
+        // 容器自带索引不可靠时在后台建立关键帧索引，跳转时按字节直接定位
+        if (!realTime && KeyframeIndex::isUseful(pFormatCtx)) {
+            keyframeIndex.open(currentFile, videoIndex);
         }
 
-        SDL_CreateThread(&MainDecoder::videoThread, "video_thread", this);
+        // 滤镜链在解码线程收到第一帧时按帧的实际参数创建，输出级在显示线程创建
+        videoTid    = SDL_CreateThread(&MainDecoder::videoThread, "video_thread", this);
+        presentTid  = SDL_CreateThread(&MainDecoder::presentThread, "video_present", this);
+        hasVideo    = true;
     }
 
     setPlayState(MainDecoder::PLAYING);
 
+    // 切换延迟：从界面发出打开命令到开始播放，包括旧文件的回收和新文件的打开
+    qDebug() << "File switch latency:" << (av_gettime_relative() - cmd.issuedAt) / 1000 << "ms, open:"
+             << (av_gettime_relative() - openStart) / 1000 << "ms";
+
     while (true) {
+        // 处理暂停/跳转命令，收到停止/打开命令时设置 isStop
+        processCommands(false);
+
         // 开启文件读取循环
         if (isStop) {
             // 退出循环，线程停止
             break;
         }
 
-        /* do not read next frame & delay to release cpu utilization */
-        if (isPause) {
-            // 线程暂停
-            SDL_Delay(10);
+        /* do not read next frame while paused or read finished,
+         * just block until next command (resume, seek or stop) arrives
+         */
+        if ((isPause && previewSerial < 0) || isReadFinished) {
+            processCommands(true);
             continue;
         }
 
-/* this seek just use in playing music, while read finished
- * & have out of loop, then jump back to seek position
- */
-seek:
-        // 执行跳转操作
-        if (isSeek) {
-            if (currentType == "video") {
-                seekIndex = videoIndex;
-            } else {
-                seekIndex = audioIndex;
-            }
-
-            // 获取FFmpeg 内部时间基准(通常是 1/1000000)
-            AVRational aVRational = av_get_time_base_q();
-            // 将显示时间转换为视频内部刻度
-            seekPos = av_rescale_q(seekPos, aVRational, pFormatCtx->streams[seekIndex]->time_base);
-
-
-            // 执行跳转
-            // AVSEEK_FLAG_BACKWARD：这是一个非常稳妥的标志。它的意思是：如果 seekPos 处没有关键帧，就往**回（前）**找最近的一个 I 帧。
-            // 这样能保证跳转后画面能立即正常显示，而不是花屏。
-
-
-            if (av_seek_frame(pFormatCtx, seekIndex, seekPos, AVSEEK_FLAG_BACKWARD) < 0) {
-                qDebug() << "Seek failed.";
-                av_seek_frame(pFormatCtx, seekIndex, seekPos, AVSEEK_FLAG_ANY);
-            } else {
-                isReadFinished = false;
-                // 清空音频解码缓存
-                audioDecoder->emptyAudioData();
-
-                double targetTimeSec = seekPos * av_q2d(pFormatCtx->streams[seekIndex]->time_base);
-                audioDecoder->setClock(targetTimeSec);
-                audioDecoder->packetEnqueue(&seekPacket);
-
-                if (currentType == "video") {
-                    // 清空视频包队列
-                    videoQueue.empty();
-                    videoQueue.enqueue(&seekPacket);
-                    // 先重置时间戳
-                    videoClk = 0;
-                }
+        // 队列已满则阻塞等待消费者取走数据，被命令打断时回到循环开头处理命令
+        if (currentType == "video") {
+            if (!videoQueue.waitForSpace()) {
+                continue;
             }
-            // 重置标志位
-            isSeek = false;
         }
 
-        if (currentType == "video") {
-            if (videoQueue.queueSize() > 512) {
-                // 若文件缓冲区已满则等待
-                SDL_Delay(10);
+        if (audioIndex >= 0) {
+            if (!audioDecoder->getPacketQueue()->waitForSpace()) {
                 continue;
             }
         }
 
         /* judge haven't reall all frame */
-        if (av_read_frame(pFormatCtx, packet) < 0){
+        qint64 readStart = av_gettime_relative();
+        TRACE_BEGIN("read_packet");
+        ret = av_read_frame(pFormatCtx, packet);
+        TRACE_END("read_packet");
+        demuxCounter.add(av_gettime_relative() - readStart);
+
+        if (ret < 0) {
+            if (ret == AVERROR_EXIT || abortRequest) {
+                // 被停止/打开命令打断，回到循环开头处理命令
+                continue;
+            }
+
             // 文件读完
             qDebug() << "Read file completed.";
             isReadFinished = true;
             emit readFinished();
-            SDL_Delay(10);
-            break;
+            // 唤醒阻塞在空队列上的视频、音频解码线程，让它们解码完剩余数据后结束
+            videoQueue.abort();
+            audioDecoder->getPacketQueue()->abort();
+            continue;
         }
 
         if (packet->stream_index == videoIndex && currentType == "video") {
             videoQueue.enqueue(packet);             // 存入视频队列
+            TRACE_COUNTER("video_queue_packets", videoQueue.queueSize());
+        }
+        else if (packet->stream_index == audioIndex && isScrubbing) {
+            av_packet_unref(packet);                // 拖动预览时不播放声音
         }
         else if (packet->stream_index == audioIndex) {
             audioDecoder->packetEnqueue(packet);    // 存入音频队列
+            TRACE_COUNTER("audio_queue_packets", audioDecoder->getPacketQueue()->queueSize());
         } else if (packet->stream_index == subtitleIndex) {
             //subtitleQueue.enqueue(packet);        // 字幕功能没有写
             av_packet_unref(packet);                // subtitle stream
@@ -710,36 +2020,61 @@ seek:
         }
     }
 
-    while (!isStop) {
-        // 不停止的时候不断检测是否需要seek
-        // 因为文件已经读取完，所以此线程不需要检测是否暂停
-        /* just use at audio playing */
-        if (isSeek) {
-            goto seek;
-        }
+fail:
+    qint64 teardownStart = av_gettime_relative();
+
+    // 通知视频解码、显示线程和音频回调停止，唤醒所有阻塞在队列和暂停上的线程
+    SDL_LockMutex(stateMutex);
+    isStop = true;
+    SDL_CondBroadcast(stateCond);
+    SDL_UnlockMutex(stateMutex);
 
-        SDL_Delay(100);
+    audioDecoder->stopAudio();
+    videoQueue.abort();
+    audioDecoder->getPacketQueue()->abort();
+    frameQueue.abort();
+
+    // 等待视频解码线程和显示线程退出
+    if (videoTid) {
+        SDL_WaitThread(videoTid, NULL);
+        videoTid = nullptr;
+    }
+
+    if (presentTid) {
+        SDL_WaitThread(presentTid, NULL);
+        presentTid = nullptr;
     }
 
-fail:
     /* close audio device */
     if (audioIndex >= 0) {
         audioDecoder->closeAudio();
     }
 
     if (currentType == "video") {
+        freeFilter();
+        keyframeIndex.close();
+
+        VideoDropStats stats = getVideoDropStats();
+        qDebug() << "Video frames late dropped:" << stats.lateDropped << ", decoder skipped:" << stats.decoderSkipped
+                 << ", display skipped:" << stats.displaySkipped;
+        if (syncErrorCount > 0) {
+            qDebug() << "A/V sync error: mean" << syncErrorSum / syncErrorCount * 1000 << "ms over" << syncErrorCount << "frames";
+        }
+        if (jitterCount > 0) {
+            qDebug() << "Presentation jitter: mean" << jitterSum / jitterCount << "us over" << jitterCount << "frames";
+        }
+
         avcodec_close(pCodecCtx);
         avcodec_free_context(&pCodecCtx);
     }
 
     avformat_close_input(&pFormatCtx);
-    avformat_free_context(pFormatCtx);
+    readAhead.close();
 
-    isReadFinished = true;
+    // 界面收到停止状态后显示封面，信箱中残留的旧帧不再显示
+    clearVideoFrame();
 
-    if (currentType == "music") {
-        setPlayState(MainDecoder::STOP);
-    }
+    setPlayState(MainDecoder::STOP);
 
-    qDebug() << "Main decoder finished.";
+    qDebug() << "Main decoder finished, teardown:" << (av_gettime_relative() - teardownStart) / 1000 << "ms";
 }
@@ -3,6 +3,10 @@
 
 #include <QThread>
 #include <QImage>
+#include <QQueue>
+#include <QMap>
+#include <QVector>
+#include <QAtomicInt>
 
 
 extern "C"
@@ -16,9 +20,16 @@ extern "C"
 #include "libavutil/opt.h"
 #include "libavcodec/avfft.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/time.h"
 }
 
 #include "audiodecoder.h"
+#include "framequeue.h"
+#include "keyframeindex.h"
+#include "mediaclock.h"
+#include "readaheadio.h"
+#include "stagecounter.h"
+#include "videofilter.h"
 
 class MainDecoder : public QThread
 {
@@ -32,24 +43,162 @@ public:
         FINISH
     };
 
+    /* 主时钟：视频帧按主时钟的时间显示 */
+    enum ClockType {
+        AUDIO_CLOCK,        // 音频播放位置（默认）
+        VIDEO_CLOCK,        // 视频自身按帧时间戳走时
+        EXTERNAL_CLOCK      // 系统单调时钟
+    };
+
+    /* 视频帧统计，主要用于观察过载时的丢帧 */
+    struct VideoDropStats {
+        int decoded;            // 视频解码器输出的帧数
+        int presented;          // 交给界面的帧数
+        int lateDropped;        // 显示线程因落后音频时钟而丢弃的帧数
+        int decoderSkipped;     // 解码器未输出的帧数（送入包数 - 输出帧数，含解码延迟中的帧和损坏的包）
+        int skipLevel;          // 当前跳帧级别：0 全部解码，1 跳过非参考帧，2 只解码关键帧
+        int displaySkipped;     // 界面来不及取走、被新帧覆盖的帧数
+    };
+
+    /* 单个滤镜的耗时统计 */
+    struct FilterCost {
+        QString name;           // 滤镜描述，"convert" 为最后的缩放和 RGB32 转换
+        qint64 frames;          // 处理的帧数
+        qint64 averageTime;     // 平均每帧耗时（微秒）
+    };
+
+    /* 管线各阶段的实时统计，界面按两次读取的差值计算这段时间内的速率和平均耗时 */
+    struct PipelineStats {
+        struct Stage {
+            qint64 count;       // 累计次数
+            qint64 totalTime;   // 累计耗时（微秒）
+            qint64 maxTime;     // 上次读取以来的最大耗时（微秒）
+        };
+        Stage demux;            // av_read_frame，每个包
+        Stage decode;           // avcodec_send_packet + avcodec_receive_frame，每个视频包
+        Stage filter;           // 滤镜链（解码线程），每个解码帧
+        Stage convert;          // 缩放及 RGB 转换（显示线程），每个显示帧
+
+        int videoPackets;       // 视频包队列
+        qint64 videoBytes;
+        qint64 videoDuration;   // 微秒
+        int audioPackets;       // 音频包队列
+        qint64 audioBytes;
+        qint64 audioDuration;   // 微秒
+        int decodedFrames;      // 已解码等待显示的帧数
+
+        double avDrift;         // 视频时钟 - 音频时钟（秒），正值表示视频超前；音视频不同时播放时为 0
+        VideoDropStats drops;
+
+        qint64 seekLatency;     // 最近一次跳转从发出命令到显示第一帧的时间（微秒），0 表示还没有跳转
+        int seekDiscarded;      // 最近一次精确跳转丢弃的视频帧数
+
+        ReadAheadIO::Stats io;  // 预读 I/O
+    };
+
     explicit MainDecoder();
     ~MainDecoder();
 
     double getCurrentTime();
+    void setMasterClock(ClockType type);
+    ClockType getMasterClockType();
+    double getMasterClock();
     void seekProgress(qint64 pos);
+    void scrubProgress(qint64 pos);
     int getVolume();
     void setVolume(int volume);
+    void setVideoDecodeThreads(int threadCount, int threadType, AVCodecID codecId = AV_CODEC_ID_NONE);
+    VideoDropStats getVideoDropStats();
+    void setVideoFilter(const QString &filter, const QString &file = QString());
+    void resetVideoFilter(const QString &file);
+    QList<FilterCost> getVideoFilterCosts();
+    void setDisplaySize(QSize size, bool keepAspectRatio);
+    bool takeVideoFrame(QImage *image);
+    void setFreeRun(bool freeRun);
+    void setAccurateSeek(bool accurate);
+    void setReadAheadSize(int size);
+    int getReadAheadSize();
+    bool getAccurateSeek();
+    void setLatencyRecording(bool enable);
+    QVector<qint64> takeFrameLatencies();
+    void setAudioOutputTap(AudioDecoder::OutputTap tap, void *opaque);
+    PipelineStats getPipelineStats();
 
 
 private:
+    /* 控制命令：界面线程只负责投递，由解复用线程（run）异步处理 */
+    enum CommandType {
+        CMD_OPEN,
+        CMD_STOP,
+        CMD_PAUSE,
+        CMD_SEEK,
+        CMD_QUIT
+    };
+
+    struct Command {
+        CommandType type;
+        QString file;       // CMD_OPEN：文件路径
+        QString fileType;   // CMD_OPEN：video / music
+        qint64 pos;         // CMD_SEEK：跳转位置（微秒）
+        bool isScrub;       // CMD_SEEK：拖动进度条时的预览跳转，只解码关键帧
+        qint64 issuedAt;    // 命令发出的时刻（av_gettime_relative，微秒），用于统计延迟
+    };
+
+    /* 一级滤镜及其输入参数，输入参数改变时需要重建 */
+    struct FilterStage {
+        QString name;               // 滤镜描述
+        VideoFilterGraph filter;
+        int width;                  // 创建时的输入帧参数
+        int height;
+        int format;
+        AVRational sar;
+        qint64 totalTime;           // 累计耗时（微秒）
+        qint64 frames;              // 处理的帧数
+    };
+
     void run();
+    void pushCommand(Command cmd);
+    bool takeCommand(Command *cmd);
+    void processCommands(bool isBlock);
+    void playFile(const Command &cmd);
+    void togglePause();
+    void doSeek(qint64 pos, qint64 issuedAt, bool isScrub);
+    void finishSeek();
+    void waitForResume();
+    void finishPlay();
+    static int interruptCallback(void *arg);
     void clearData();
     void setPlayState(MainDecoder::PlayState state);
     void displayVideo(QImage image);
+    void clearVideoFrame();
     static int videoThread(void *arg);
-    double synchronize(AVFrame *frame, double pts);
+    static int presentThread(void *arg);
+    qint64 receiveFrames(AVFrame *frame);
+    bool discardBeforeTarget(AVFrame *frame);
+    bool renderFrame(AVFrame *frame, int serial, qint64 queuedAt);
+    static void releaseImageFrame(void *info);
+    bool dropLateFrame(double lateness);
+    void resetFrameDropping();
+    void applySkipLevel();
+    void configureDecodeThreads(AVCodecContext *codecCtx, AVCodec *codec);
+    double frameDuration(AVFrame *frame);
+    double frameDelay(double framePts, ClockType clockType);
+    bool waitUntil(qint64 target, int serial);
     bool isRealtime(AVFormatContext *pFormatCtx);
-    int initFilter();
+    int createFilterStage(FilterStage *stage, const QString &name, const QString &desc,
+                          const AVFrame *frame, AVRational timeBase, bool isRgbOutput);
+    static bool isStageInputChanged(const FilterStage &stage, const AVFrame *frame);
+    void freeFilterStage(FilterStage *stage);
+    void resetFilterStage(FilterStage *stage);
+    void addFilterCost(FilterStage *stage, qint64 time, int frames);
+    int initFilter(const AVFrame *frame);
+    QString outputScaleFilter(int width, int height, AVRational sar);
+    void freeFilter();
+    bool queueFrame(AVFrame *frame);
+    bool drainFilter(AVFrame *frame, qint64 filterTime, int frames);
+    void flushFilter();
+    bool convertFrame(AVFrame *frame, AVRational timeBase);
+    QString currentVideoFilter();
 
     int fileType;
 
@@ -62,34 +211,124 @@ private:
 
     qint64 timeTotal;
 
-    AVPacket seekPacket;
-    qint64 seekPos;
-    double seekTime;
+    QQueue<Command> commandQueue;       // 待处理的控制命令
+    SDL_mutex *commandMutex;
+    SDL_cond *commandCond;
+
+    SDL_mutex *stateMutex;              // 保护暂停/停止状态的等待
+    SDL_cond *stateCond;                // 暂停恢复或停止时广播
+
+    SDL_Thread *videoTid;               // 视频解码线程，停止时等待其退出
+    SDL_Thread *presentTid;             // 视频显示线程，停止时等待其退出
 
-    PlayState playState;
-    bool isStop;        // 解复用线程及其子线程解码线程的停止标志位
-    bool gotStop;
-    bool isPause;       // 解复用线程及其子线程解码线程的暂停标志位
-    bool isSeek;
-    bool isReadFinished;                // 文件读取完成标志位
-    bool isDecodeFinished;              // 解码完成标志位
+    QAtomicInt playState;
+    QAtomicInt isStop;          // 解复用线程及其子线程解码线程的停止标志位
+    QAtomicInt isPause;         // 解复用线程及其子线程解码线程的暂停标志位
+    QAtomicInt isReadFinished;  // 文件读取完成标志位
+    QAtomicInt isFinished;      // 已通知播放完成，避免音频和视频重复通知
+    QAtomicInt abortRequest;    // 有待处理的停止/打开命令，用于打断阻塞的 I/O
+    QAtomicInt isFreeRun;       // 全速运行：不按时间戳等待、不丢迟到帧（性能测试用）
+    QAtomicInt hasVideo;        // 当前文件有视频显示线程
+
+    /* 跳转 */
+    QAtomicInt isAccurateSeek;              // 精确跳转：从关键帧解码，丢弃目标之前的帧和音频采样
+    QAtomicInteger<qint64> seekTarget;      // 最近一次跳转的目标（微秒），AV_NOPTS_VALUE 表示不丢弃
+    QAtomicInteger<qint64> seekIssuedAt;    // 最近一次跳转命令发出的时刻，0 表示没有等待显示的跳转
+    QAtomicInteger<qint64> lastSeekLatency; // 最近一次跳转从发出命令到显示第一帧的时间（微秒）
+    QAtomicInt lastSeekDiscarded;           // 最近一次精确跳转丢弃的视频帧数
+    QAtomicInt isScrubbing;                 // 拖动预览中：只解码关键帧并立即显示，丢弃音频包
+    QAtomicInt previewSerial;               // 需要立即显示第一帧的播放序列（暂停时也显示），-1 表示没有
+    qint64 discardTarget;                   // 当前序列丢弃到的目标（微秒，解码线程）
+    int discardedFrames;                    // 当前序列已丢弃的帧数（解码线程）
 
     AVFormatContext *pFormatCtx;
 
+    ReadAheadIO readAhead;              // 本地文件的预读 I/O
+    QAtomicInt readAheadSize;           // 预读缓冲区大小（字节），0 表示不预读
+
     AVCodecContext *pCodecCtx;          // video codec context
 
+    /* 视频解码线程配置 */
+    struct DecodeThreadConfig {
+        int threadCount;    // 解码线程数，<= 0 表示使用 CPU 核心数
+        int threadType;     // FF_THREAD_FRAME / FF_THREAD_SLICE 的组合
+    };
+    // 按解码器 ID 单独配置，AV_CODEC_ID_NONE 为默认配置
+    QMap<int, DecodeThreadConfig> decodeThreadConfigs;
+
     AvPacketQueue videoQueue;           // 原始帧队列
+    FrameQueue frameQueue;              // 解码后的视频帧队列（解码线程 -> 显示线程）
     AvPacketQueue subtitleQueue;
 
     AVStream *videoStream;
 
-    double videoClk;    // video frame timestamp
+    KeyframeIndex keyframeIndex;        // 视频流的关键帧索引，容器索引不可靠时用于跳转
+
+    int videoSerial;    // 视频解码器当前所处的播放序列号（解码线程）
+
+    QAtomicInt masterClockType;     // 选择的主时钟，对应流不存在时自动退回其它时钟
+    MediaClock videoClock;          // 视频时钟：最近显示的一帧的时间戳，按系统时间走时
+    MediaClock externalClock;       // 外部时钟：开始播放和跳转时设置，按系统时间走时
+    int presentSerial;  // 显示线程当前所处的播放序列号（显示线程）
+    bool isSeekPending; // 新序列还没有帧交给界面，此时不按迟到丢帧（显示线程）
+
+    /* 显示调度（显示线程） */
+    qint64 frameTimer;              // 上一帧的目标显示时刻（av_gettime_relative，微秒），0 表示尚未开始
+    double lastFramePts;            // 上一帧的时间戳（秒）
+    double lastFrameDuration;       // 上一帧自身的时长（秒）
+
+    /* 迟到帧丢弃与解码器跳帧 */
+    QAtomicInt lateFramesDropped;   // 显示线程丢弃的迟到帧数
+    QAtomicInt videoPacketsSent;    // 送入视频解码器的包数
+    QAtomicInt videoFramesDecoded;  // 视频解码器输出的帧数
+    QAtomicInt videoFramesPresented; // 交给界面的帧数
+    QAtomicInt skipLevel;           // 期望的跳帧级别，由显示线程调整、解码线程应用
+    int appliedSkipLevel;           // 解码器当前使用的跳帧级别（解码线程）
+    int lateStreak;                 // 连续丢弃的迟到帧数（显示线程）
+    qint64 lastLateTime;            // 最近一次丢弃迟到帧的时刻（显示线程）
+    qint64 skipLevelChangedAt;      // 最近一次调整跳帧级别的时刻（显示线程）
+
+    /* 各阶段耗时，一直开启 */
+    StageCounter demuxCounter;      // 解复用线程
+    StageCounter decodeCounter;     // 视频解码线程
+    StageCounter filterCounter;     // 视频解码线程（滤镜链）
+    StageCounter convertCounter;    // 显示线程（缩放及 RGB 转换）
+
+    double syncErrorSum;            // 送显时刻音视频偏差的累计值（秒，显示线程）
+    int syncErrorCount;
+    qint64 jitterSum;               // 实际送显时刻与目标时刻偏差的累计值（微秒，显示线程）
+    int jitterCount;
 
     AudioDecoder *audioDecoder;
 
-    AVFilterGraph   *filterGraph;
-    AVFilterContext *filterSinkCxt;
-    AVFilterContext *filterSrcCxt;
+    /* 视频滤镜：用户滤镜链整体是一个 graph，在解码线程中运行并把输出的每一帧放入帧队列；
+     * 缩放和 RGB 转换单独一级，在显示线程中只处理真正显示的帧，显示区域改变时单独重建 */
+    FilterStage chainStage;             // 解码线程使用，统计数据由 filterMutex 保护
+    bool isFilterInited;                // 滤镜链已按当前帧参数创建（解码线程）
+    FilterStage outputStage;            // 显示线程使用，统计数据由 filterMutex 保护
+    AVRational frameTimeBase;           // 当前显示帧的时间基（显示线程）
+    SDL_mutex *filterMutex;
+
+    QString videoFilter;                    // 全局滤镜链，由 commandMutex 保护
+    QMap<QString, QString> fileVideoFilters; // 按文件单独配置的滤镜链，由 commandMutex 保护
+    QString activeFilter;                   // 当前滤镜链对应的配置（解码线程）
+    QAtomicInt filterChanged;               // 滤镜配置已改变，解码线程在下一帧重建
+
+    QSize displaySize;                      // 界面显示区域大小，由 commandMutex 保护
+    bool keepAspectRatio;                   // 是否保持长宽比，由 commandMutex 保护
+    QAtomicInt displayChanged;              // 显示区域已改变，显示线程在下一帧重建输出级
+
+    /* 单帧信箱：显示线程放入最新一帧，界面重绘时取走 */
+    QImage pendingImage;                    // 等待界面取走的帧，由 imageMutex 保护
+    bool hasPendingImage;
+    SDL_mutex *imageMutex;
+    QAtomicInt imageNotified;               // 已通知界面、界面还没取帧
+    QAtomicInt displaySkipped;              // 被新帧覆盖的帧数
+
+    /* 每帧从解码完成到交给界面的延迟（微秒），开启记录时由显示线程追加 */
+    QAtomicInt latencyRecording;
+    QVector<qint64> frameLatencies;         // 由 latencyMutex 保护
+    SDL_mutex *latencyMutex;
 
 public slots:
     void decoderFile(QString file, QString type);
@@ -99,9 +338,10 @@ public slots:
 
 signals:
     void readFinished();
-    void gotVideo(QImage image);
+    void gotVideo();
     void gotVideoTime(qint64 time);
     void playStateChanged(MainDecoder::PlayState state);
+    void seekFinished(qint64 latency);
 
 };
 
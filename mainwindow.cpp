@@ -2,15 +2,20 @@
 #include <QStandardPaths>
 #include <QPainter>
 #include <QCloseEvent>
+#include <QResizeEvent>
 #include <QEvent>
 #include <QFileInfoList>
 #include <QMenu>
 #include <QMessageBox>
 #include <QDebug>
 #include <QMovie>
+#include <QDateTime>
+#include <QDir>
+#include <QStyle>
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "tracer.h"
 
 extern "C"
 {
@@ -25,24 +30,34 @@ MainWindow::MainWindow(QWidget *parent) :
     m_MainDecoder(new MainDecoder),
     m_menuTimer(new QTimer),
     m_progressTimer(new QTimer),
+    m_statsTimer(new QTimer),
     menuIsVisible(true),
     isKeepAspectRatio(false),
+    isStatsVisible(false),
     m_video_image(QImage(":/image/MUSIC.jpg")),
     autoPlay(true),
     loopPlay(false),
     closeNotExit(false),
     playState(MainDecoder::STOP),
     seekInterval(5),
+    isScrubbing(false),
+    m_thumbnails(new ThumbnailProvider(this)),
+    m_thumbLabel(nullptr),
+    m_hoverSecond(-1),
+    m_hoverX(0),
     m_bDrag(false)
 {
     ui->setupUi(this);
 
     qRegisterMetaType<MainDecoder::PlayState>("MainDecoder::PlayState");
 
+    TRACE_THREAD_NAME("gui");
+
     ///每隔3秒，检测状态，自动隐藏
     m_menuTimer->start(3000);
 
     m_progressTimer->setInterval(500);
+    m_statsTimer->setInterval(500);
 
     initUI();
     initTray();
@@ -92,6 +107,13 @@ void MainWindow::initUI()
 
     // 安装滚动条事过滤器
     ui->videoProgressSlider->installEventFilter(this);
+
+    // 悬停缩略图，鼠标移过进度条时显示
+    ui->videoProgressSlider->setMouseTracking(true);
+    m_thumbLabel = new QLabel(this);
+    m_thumbLabel->setStyleSheet("background-color:#000;border:1px solid #fff;");
+    m_thumbLabel->setAttribute(Qt::WA_TransparentForMouseEvents);
+    m_thumbLabel->hide();
 }
 
 void MainWindow::initFFmpeg()
@@ -129,9 +151,12 @@ void MainWindow::initSlot()
     // 3. 定时器连接
     connect(m_menuTimer,     &QTimer::timeout, this, &MainWindow::timerSlot);
     connect(m_progressTimer, &QTimer::timeout, this, &MainWindow::timerSlot);
+    connect(m_statsTimer,    &QTimer::timeout, this, &MainWindow::timerSlot);
 
     // 4. 进度条拖动
-    connect(ui->videoProgressSlider, &QSlider::sliderMoved, this, &MainWindow::seekProgress);
+    // 拖动时只预览关键帧，松开后跳转到最终位置
+    connect(ui->videoProgressSlider, &QSlider::sliderMoved,     this, &MainWindow::scrubProgress);
+    connect(ui->videoProgressSlider, &QSlider::sliderReleased,  this, &MainWindow::finishScrub);
 
     // 5. MainWindow 发出的指令信号 (连向解码器)
     connect(this, &MainWindow::selectedVideoFile, m_MainDecoder, &MainDecoder::decoderFile);
@@ -142,6 +167,9 @@ void MainWindow::initSlot()
     connect(m_MainDecoder, &MainDecoder::playStateChanged, this, &MainWindow::playStateChanged);
     connect(m_MainDecoder, &MainDecoder::gotVideoTime,     this, &MainWindow::videoTime);
     connect(m_MainDecoder, &MainDecoder::gotVideo,         this, &MainWindow::showVideo);
+
+    // 7. 缩略图解码完成
+    connect(m_thumbnails, &ThumbnailProvider::thumbnailReady, this, &MainWindow::thumbnailReady);
 }
 
 void MainWindow::initTray()
@@ -179,6 +207,9 @@ void MainWindow::paintEvent(QPaintEvent *event)
 {
     // 忽略参数
     Q_UNUSED(event);
+    // 绘制耗时计入统计面板的 paint 阶段
+    qint64 paintStart = av_gettime_relative();
+    TRACE_SCOPE("paint");
     // 创建画笔对象，画布为this
     QPainter painter(this);
     // 抗锯齿
@@ -187,25 +218,56 @@ void MainWindow::paintEvent(QPaintEvent *event)
     int width = this->width();
     int height = this->height();
 
+    // 取出解码器信箱中最新的一帧，中间来不及显示的帧已被覆盖
+    m_MainDecoder->takeVideoFrame(&m_video_image);
+
     // 用黑色填充窗口
     painter.setBrush(Qt::black);
     painter.drawRect(0, 0, width, height);
+    /* 视频帧已在解码管线中缩放到窗口大小，尺寸一致时直接拷贝到屏幕；
+     * 窗口刚改变大小、新尺寸的帧还没到达时（或显示封面图片时）由 QPainter 绘制时缩放
+     */
+    QRect target;
     // 是否保持纵横比
     if (isKeepAspectRatio) {
         // 保持
-        QImage img = m_video_image.scaled(QSize(width, height), Qt::KeepAspectRatio);
+        QSize size = m_video_image.size().scaled(QSize(width, height), Qt::KeepAspectRatio);
 
         /* calculate display position */
-        int x = (this->width() - img.width()) / 2;
-        int y = (this->height() - img.height()) / 2;
+        int x = (this->width() - size.width()) / 2;
+        int y = (this->height() - size.height()) / 2;
 
-        painter.drawImage(QPoint(x, y), img);
+        target = QRect(QPoint(x, y), size);
     } else {
         // 不保持，填满窗口
-        QImage img = m_video_image.scaled(QSize(width, height));
+        target = QRect(0, 0, width, height);
+    }
 
-        painter.drawImage(QPoint(0, 0), img);
+    if (target.size() == m_video_image.size()) {
+        painter.drawImage(target.topLeft(), m_video_image);
+    } else {
+        painter.drawImage(target, m_video_image);
+    }
+
+    // 统计面板：左上角半透明背景上的等宽文字
+    if (isStatsVisible && !m_statsText.isEmpty()) {
+        painter.setFont(QFont("Consolas", 10));
+        QRect textRect = painter.fontMetrics().boundingRect(QRect(16, 16, width - 32, height - 32),
+                                                            Qt::AlignLeft | Qt::AlignTop, m_statsText);
+        painter.fillRect(textRect.adjusted(-8, -8, 8, 8), QColor(0, 0, 0, 160));
+        painter.setPen(Qt::white);
+        painter.drawText(textRect, Qt::AlignLeft | Qt::AlignTop, m_statsText);
     }
+
+    m_paintCounter.add(av_gettime_relative() - paintStart);
+}
+
+// 窗口大小改变时通知解码器，按新的尺寸输出视频帧
+void MainWindow::resizeEvent(QResizeEvent *event)
+{
+    QMainWindow::resizeEvent(event);
+
+    m_MainDecoder->setDisplaySize(size(), isKeepAspectRatio);
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -248,6 +310,11 @@ bool MainWindow::eventFilter(QObject *object, QEvent *event)
                     decoder->seekProgress(static_cast<qint64>(pos) * 1000000);
                 }
             }*/
+        } else if (event->type() == QEvent::MouseMove) {
+            showThumbnail(static_cast<QMouseEvent *>(event)->x());
+        } else if (event->type() == QEvent::Leave) {
+            m_hoverSecond = -1;
+            m_thumbLabel->hide();
         }
     }
 
@@ -256,7 +323,8 @@ bool MainWindow::eventFilter(QObject *object, QEvent *event)
 
 void MainWindow::keyReleaseEvent(QKeyEvent *event)
 {
-    int progressVal;
+    // 以当前播放时间为基准跳转，不取整到进度条的整秒
+    double currentTime = m_MainDecoder->getCurrentTime();
     int volumnVal = m_MainDecoder->getVolume();
 
 
@@ -281,18 +349,15 @@ void MainWindow::keyReleaseEvent(QKeyEvent *event)
 
     case Qt::Key_Left:
         // 快退
-        if (ui->videoProgressSlider->value() > seekInterval) {
-            progressVal = ui->videoProgressSlider->value() - seekInterval;
-            m_MainDecoder->seekProgress(static_cast<qint64>(progressVal) * 1000000);
+        if (currentTime > seekInterval) {
+            m_MainDecoder->seekProgress(static_cast<qint64>((currentTime - seekInterval) * 1000000));
         }
         break;
 
     case Qt::Key_Right:
         // 快进
-        if (ui->videoProgressSlider->value() + seekInterval < ui->videoProgressSlider->maximum()) {
-
-            progressVal = ui->videoProgressSlider->value() + seekInterval;
-            m_MainDecoder->seekProgress(static_cast<qint64>(progressVal) * 1000000);
+        if (currentTime + seekInterval < ui->videoProgressSlider->maximum()) {
+            m_MainDecoder->seekProgress(static_cast<qint64>((currentTime + seekInterval) * 1000000));
         }
         break;
 
@@ -306,6 +371,19 @@ void MainWindow::keyReleaseEvent(QKeyEvent *event)
         emit pauseVideo();
         break;
 
+    case Qt::Key_I:
+        // 显示/隐藏统计面板
+        setStatsVisible();
+        break;
+
+#ifdef ENABLE_TRACE
+    case Qt::Key_T:
+        // 导出各线程最近的活动到临时目录
+        Tracer::dump(QDir(QStandardPaths::writableLocation(QStandardPaths::TempLocation)).filePath(
+                         QString("FFmpegQtPlayer-trace-%1.json").arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"))));
+        break;
+#endif
+
     default:
         QMainWindow::keyPressEvent(event);
         break;
@@ -401,17 +479,33 @@ void MainWindow::showPlayMenu()
 
     QAction *captureAction = new QAction("截图", this);
 
+    QAction *statsAction = new QAction("统计信息", this);
+    statsAction->setCheckable(true);
+    if (isStatsVisible) {
+        statsAction->setChecked(true);
+    }
+
+    QAction *accurateSeekAction = new QAction("精确跳转", this);
+    accurateSeekAction->setCheckable(true);
+    if (m_MainDecoder->getAccurateSeek()) {
+        accurateSeekAction->setChecked(true);
+    }
+
     connect(fullSrcAction,      SIGNAL(triggered(bool)), this, SLOT(setFullScreen()));
     connect(keepRatioAction,    SIGNAL(triggered(bool)), this, SLOT(setKeepRatio()));
     connect(autoPlayAction,     SIGNAL(triggered(bool)), this, SLOT(setAutoPlay()));
     connect(loopPlayAction,     SIGNAL(triggered(bool)), this, SLOT(setLoopPlay()));
     connect(captureAction,      SIGNAL(triggered(bool)), this, SLOT(saveCurrentFrame()));
+    connect(statsAction,        SIGNAL(triggered(bool)), this, SLOT(setStatsVisible()));
+    connect(accurateSeekAction, SIGNAL(triggered(bool)), this, SLOT(setAccurateSeek()));
 
     menu->addAction(fullSrcAction);
     menu->addAction(keepRatioAction);
     menu->addAction(autoPlayAction);
     menu->addAction(loopPlayAction);
     menu->addAction(captureAction);
+    menu->addAction(statsAction);
+    menu->addAction(accurateSeekAction);
 
     menu->exec(QCursor::pos());
 
@@ -420,12 +514,16 @@ void MainWindow::showPlayMenu()
     disconnect(autoPlayAction,  SIGNAL(triggered(bool)), this, SLOT(setAutoPlay()));
     disconnect(loopPlayAction,  SIGNAL(triggered(bool)), this, SLOT(setLoopPlay()));
     disconnect(captureAction,       SIGNAL(triggered(bool)), this, SLOT(saveCurrentFrame()));
+    disconnect(statsAction,     SIGNAL(triggered(bool)), this, SLOT(setStatsVisible()));
+    disconnect(accurateSeekAction, SIGNAL(triggered(bool)), this, SLOT(setAccurateSeek()));
 
     delete fullSrcAction;
     delete keepRatioAction;
     delete autoPlayAction;
     delete loopPlayAction;
     delete captureAction;
+    delete statsAction;
+    delete accurateSeekAction;
     delete menu;
 }
 
@@ -444,9 +542,56 @@ void MainWindow::showControls(bool show)
         for (QWidget *widget : m_hideVector) {
             widget->hide();
         }
+        m_hoverSecond = -1;
+        m_thumbLabel->hide();
     }
 }
 
+/**
+ * @brief 显示进度条上鼠标位置的缩略图，还没有缓存时请求后台解码，完成后由 thumbnailReady() 显示
+ * @param x 鼠标在进度条上的横坐标
+ */
+void MainWindow::showThumbnail(int x)
+{
+    QSlider *slider = ui->videoProgressSlider;
+    QImage image;
+
+    if (timeTotal <= 0) {
+        return;
+    }
+
+    m_hoverX = x;
+    m_hoverSecond = QStyle::sliderValueFromPosition(slider->minimum(), slider->maximum(), x, slider->width());
+
+    // 没有缓存时保留上一张缩略图，只移动位置
+    if (m_thumbnails->thumbnail(m_hoverSecond, &image)) {
+        QPixmap pixmap = QPixmap::fromImage(image);
+        QPainter painter(&pixmap);
+
+        // 底部叠加时间
+        painter.setPen(Qt::white);
+        painter.drawText(pixmap.rect().adjusted(0, 0, 0, -2), Qt::AlignHCenter | Qt::AlignBottom,
+                         QString("%1:%2:%3")
+                         .arg(m_hoverSecond / 3600, 2, 10, QLatin1Char('0'))
+                         .arg((m_hoverSecond / 60) % 60, 2, 10, QLatin1Char('0'))
+                         .arg(m_hoverSecond % 60, 2, 10, QLatin1Char('0')));
+        painter.end();
+
+        m_thumbLabel->setPixmap(pixmap);
+        m_thumbLabel->adjustSize();
+    } else if (!m_thumbLabel->isVisible()) {
+        return;
+    }
+
+    // 居中在鼠标上方，不超出窗口
+    QPoint pos = slider->mapTo(this, QPoint(x, 0));
+    int left = qBound(0, pos.x() - m_thumbLabel->width() / 2, width() - m_thumbLabel->width());
+
+    m_thumbLabel->move(left, pos.y() - m_thumbLabel->height() - 4);
+    m_thumbLabel->raise();
+    m_thumbLabel->show();
+}
+
 inline QString MainWindow::getFilenameFromPath(QString path)
 {
     return path.right(path.size() - path.lastIndexOf("/") - 1);
@@ -505,6 +650,13 @@ void MainWindow::playVideo(QString file)
         ui->titleLable->setVisible(true);
     }
 
+    // 本地视频文件生成悬停缩略图
+    if (currentPlayType == "video") {
+        m_thumbnails->open(file);
+    } else {
+        m_thumbnails->close();
+    }
+
     emit selectedVideoFile(file, currentPlayType);
 }
 
@@ -528,6 +680,7 @@ void MainWindow::buttonClickSlot()
         filePath = ui->lineEdit->text();
         if (!filePath.isNull() && !filePath.isEmpty()) {
             QString type = "video";
+            m_thumbnails->close();
             emit selectedVideoFile(filePath, type);
         }
     } else if (QObject::sender() == ui->btnStop) {
@@ -566,6 +719,8 @@ void MainWindow::setFullScreen()
 void MainWindow::setKeepRatio()
 {
     isKeepAspectRatio = !isKeepAspectRatio;
+
+    m_MainDecoder->setDisplaySize(size(), isKeepAspectRatio);
 }
 
 void MainWindow::setAutoPlay()
@@ -586,9 +741,109 @@ void MainWindow::saveCurrentFrame()
     m_video_image.save(filename);
 }
 
+// 显示/隐藏统计面板，隐藏时停止采样
+void MainWindow::setStatsVisible()
+{
+    isStatsVisible = !isStatsVisible;
+
+    if (isStatsVisible) {
+        // 以当前值作为第一次采样的基准
+        m_lastStats     = m_MainDecoder->getPipelineStats();
+        m_lastPaint.count       = m_paintCounter.count();
+        m_lastPaint.totalTime   = m_paintCounter.totalTime();
+        m_paintCounter.takeMaxTime();
+        m_lastStatsTime = av_gettime_relative();
+        m_statsText     = "...";
+        m_statsTimer->start();
+    } else {
+        m_statsTimer->stop();
+    }
+
+    update();
+}
+
+// 切换精确跳转：从关键帧解码到目标位置再显示，较慢但画面和声音都从目标处开始
+void MainWindow::setAccurateSeek()
+{
+    m_MainDecoder->setAccurateSeek(!m_MainDecoder->getAccurateSeek());
+}
+
+// 一个阶段在采样间隔内的速率、平均耗时和最大耗时
+static QString formatStage(const QString &name, const MainDecoder::PipelineStats::Stage &now,
+                           const MainDecoder::PipelineStats::Stage &last, double seconds)
+{
+    qint64 count    = now.count - last.count;
+    qint64 total    = now.totalTime - last.totalTime;
+
+    // 新文件开始时计数器清零，差值为负，这一次只显示当前值
+    if (count < 0 || total < 0) {
+        count   = now.count;
+        total   = now.totalTime;
+    }
+
+    return QString("%1 %2/s  avg %3 ms  max %4 ms\n")
+            .arg(name, -8)
+            .arg(count / seconds, 7, 'f', 1)
+            .arg(count > 0 ? total / 1000.0 / count : 0, 6, 'f', 2)
+            .arg(now.maxTime / 1000.0, 6, 'f', 2);
+}
+
+// 采样解码器统计并刷新统计面板
+void MainWindow::updateStats()
+{
+    MainDecoder::PipelineStats stats = m_MainDecoder->getPipelineStats();
+    MainDecoder::PipelineStats::Stage paint;
+    qint64 now = av_gettime_relative();
+    double seconds = FFMAX(now - m_lastStatsTime, 1) / 1e6;
+
+    paint.count     = m_paintCounter.count();
+    paint.totalTime = m_paintCounter.totalTime();
+    paint.maxTime   = m_paintCounter.takeMaxTime();
+
+    QString text;
+    text += formatStage("Demux",  stats.demux,  m_lastStats.demux,  seconds);
+    text += formatStage("Decode", stats.decode, m_lastStats.decode, seconds);
+    text += formatStage("Filter", stats.filter, m_lastStats.filter, seconds);
+    text += formatStage("Convert", stats.convert, m_lastStats.convert, seconds);
+    text += formatStage("Paint",  paint,        m_lastPaint,        seconds);
+    text += QString("Video queue  %1 pkts  %2 KB  %3 s\n")
+            .arg(stats.videoPackets).arg(stats.videoBytes / 1024).arg(stats.videoDuration / 1e6, 0, 'f', 2);
+    text += QString("Audio queue  %1 pkts  %2 KB  %3 s\n")
+            .arg(stats.audioPackets).arg(stats.audioBytes / 1024).arg(stats.audioDuration / 1e6, 0, 'f', 2);
+    text += QString("Frame queue  %1\n").arg(stats.decodedFrames);
+    text += QString("A/V drift    %1 ms\n").arg(stats.avDrift * 1000, 0, 'f', 1);
+    text += QString("Frames       decoded %1  presented %2\n").arg(stats.drops.decoded).arg(stats.drops.presented);
+    text += QString("Dropped      late %1  decoder %2  display %3  skip level %4")
+            .arg(stats.drops.lateDropped).arg(stats.drops.decoderSkipped)
+            .arg(stats.drops.displaySkipped).arg(stats.drops.skipLevel);
+    if (stats.seekLatency > 0) {
+        text += QString("\nLast seek    %1 ms  %2  discarded %3 frames")
+                .arg(stats.seekLatency / 1000.0, 0, 'f', 1)
+                .arg(m_MainDecoder->getAccurateSeek() ? "accurate" : "fast")
+                .arg(stats.seekDiscarded);
+    }
+    if (stats.io.bufferSize > 0) {
+        text += QString("\nRead-ahead   %1/%2 MB  %3 MB/s  stalls %4  %5 ms")
+                .arg(stats.io.buffered / 1048576.0, 0, 'f', 1)
+                .arg(stats.io.bufferSize / 1048576.0, 0, 'f', 1)
+                .arg(FFMAX(stats.io.bytesRead - m_lastStats.io.bytesRead, 0) / 1048576.0 / seconds, 0, 'f', 1)
+                .arg(FFMAX(stats.io.stalls - m_lastStats.io.stalls, 0))
+                .arg(FFMAX(stats.io.stallTime - m_lastStats.io.stallTime, 0) / 1000.0, 0, 'f', 1);
+    }
+
+    m_statsText     = text;
+    m_lastStats     = stats;
+    m_lastPaint     = paint;
+    m_lastStatsTime = now;
+
+    update();
+}
+
 void MainWindow::timerSlot()
 {
-    if (QObject::sender() == m_menuTimer) {
+    if (QObject::sender() == m_statsTimer) {
+        updateStats();
+    } else if (QObject::sender() == m_menuTimer) {
         if (menuIsVisible && playState == MainDecoder::PLAYING) {
             if (isFullScreen()) {
                 QApplication::setOverrideCursor(Qt::BlankCursor);
@@ -601,7 +856,10 @@ void MainWindow::timerSlot()
             return;
         }
         qint64 currentTime = static_cast<qint64>(m_MainDecoder->getCurrentTime());
-        ui->videoProgressSlider->setValue( static_cast<int>(currentTime) );
+        // 拖动中不更新进度条，避免滑块从鼠标下跳走
+        if (!ui->videoProgressSlider->isSliderDown()) {
+            ui->videoProgressSlider->setValue( static_cast<int>(currentTime) );
+        }
 
         ///qDebug() << "currentTime::" << currentTime;
         int hourCurrent = currentTime / 60 / 60;
@@ -627,6 +885,29 @@ void MainWindow::seekProgress(int value)
     m_MainDecoder->seekProgress(static_cast<qint64>(value) * 1000000);
 }
 
+void MainWindow::scrubProgress(int value)
+{
+    isScrubbing = true;
+    m_MainDecoder->scrubProgress(static_cast<qint64>(value) * 1000000);
+}
+
+// 拖动结束：跳转到最终位置并恢复完整解码
+void MainWindow::finishScrub()
+{
+    if (isScrubbing) {
+        isScrubbing = false;
+        seekProgress(ui->videoProgressSlider->value());
+    }
+}
+
+// 后台解码出缩略图，鼠标仍停在该位置时显示
+void MainWindow::thumbnailReady(int second)
+{
+    if (second == m_hoverSecond) {
+        showThumbnail(m_hoverX);
+    }
+}
+
 void MainWindow::editText()
 {
     /* forbid control hide while inputting */
@@ -650,9 +931,9 @@ void MainWindow::videoTime(qint64 time)
                            .arg(sec,  2, 10, QLatin1Char('0')));
 }
 
-void MainWindow::showVideo(QImage image)
+// 解码器信箱中有新帧，请求重绘，重绘时再取最新的一帧
+void MainWindow::showVideo()
 {
-    this->m_video_image = image;
     update();
 }
 
@@ -7,8 +7,10 @@
 #include <QTimer>
 #include <QVector>
 #include <QList>
+#include <QLabel>
 
 #include "maindecoder.h"
+#include "thumbnailprovider.h"
 
 namespace Ui {
 class MainWindow;
@@ -24,6 +26,7 @@ public:
 
 private:
     void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
     void closeEvent(QCloseEvent *event) override;
     void changeEvent(QEvent *event) override;
     void keyReleaseEvent(QKeyEvent *event) override;
@@ -45,6 +48,8 @@ private:
 
     void setHide(QWidget *widget);
     void showControls(bool show);
+    void updateStats();
+    void showThumbnail(int x);
 
     inline QString getFilenameFromPath(QString path);
 
@@ -62,12 +67,21 @@ private:
 
     QTimer *m_menuTimer;      // menu hide timer
     QTimer *m_progressTimer;  // check play progress timer
+    QTimer *m_statsTimer;     // refresh stats overlay timer
 
     bool menuIsVisible;     // switch to control show/hide menu
     bool isKeepAspectRatio; // switch to control image scale whether keep aspect ratio
+    bool isStatsVisible;    // switch to control show/hide pipeline stats overlay
 
     QImage m_video_image;
 
+    /* 统计面板：按两次采样的差值显示这段时间内各阶段的速率和耗时 */
+    QString m_statsText;
+    MainDecoder::PipelineStats m_lastStats;
+    MainDecoder::PipelineStats::Stage m_lastPaint;
+    StageCounter m_paintCounter;        // paintEvent 耗时
+    qint64 m_lastStatsTime;             // 上次采样时刻（av_gettime_relative，微秒）
+
     bool autoPlay;          // switch to control whether to continue to playing other file
     bool loopPlay;          // switch to control whether to continue to playing same file
     bool closeNotExit;      // switch to control click exit button not exit but hide
@@ -78,6 +92,13 @@ private:
 
     qint64 timeTotal;
     int seekInterval;
+    bool isScrubbing;       // 正在拖动进度条预览
+
+    /* 进度条悬停缩略图 */
+    ThumbnailProvider *m_thumbnails;
+    QLabel *m_thumbLabel;
+    int m_hoverSecond;      // 鼠标所在的进度条位置（秒），-1 表示不在进度条上
+    int m_hoverX;           // 鼠标在进度条上的横坐标
 
 private slots:
     void buttonClickSlot();
@@ -85,6 +106,9 @@ private slots:
     void timerSlot();
     void editText();
     void seekProgress(int value);
+    void scrubProgress(int value);
+    void finishScrub();
+    void thumbnailReady(int second);
     void videoTime(qint64 time);
     void playStateChanged(MainDecoder::PlayState state);
 
@@ -94,8 +118,10 @@ private slots:
     void setAutoPlay();
     void setLoopPlay();
     void saveCurrentFrame();
+    void setStatsVisible();
+    void setAccurateSeek();
 
-    void showVideo(QImage);
+    void showVideo();
 
 
 signals:
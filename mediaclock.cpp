@@ -0,0 +1,58 @@
+﻿extern "C"
+{
+#include "libavutil/time.h"
+}
+
+#include "mediaclock.h"
+
+MediaClock::MediaClock() :
+    pts(0),
+    updatedAt(0),
+    isPaused(false)
+{
+    mutex = SDL_CreateMutex();
+    updatedAt = av_gettime_relative();
+}
+
+MediaClock::~MediaClock()
+{
+    SDL_DestroyMutex(mutex);
+}
+
+// 当前时间（秒），可在任意线程调用
+double MediaClock::get()
+{
+    double ret;
+
+    SDL_LockMutex(mutex);
+    if (isPaused) {
+        ret = pts;
+    } else {
+        ret = pts + static_cast<double>(av_gettime_relative() - updatedAt) / AV_TIME_BASE;
+    }
+    SDL_UnlockMutex(mutex);
+
+    return ret;
+}
+
+// 以当前时刻为基准设置时间，之后从该时间开始走时
+void MediaClock::set(double pts)
+{
+    SDL_LockMutex(mutex);
+    this->pts   = pts;
+    updatedAt   = av_gettime_relative();
+    SDL_UnlockMutex(mutex);
+}
+
+// 暂停时停在当前时间，恢复后从该时间继续走时
+void MediaClock::setPaused(bool paused)
+{
+    SDL_LockMutex(mutex);
+    qint64 now = av_gettime_relative();
+    if (!isPaused) {
+        pts += static_cast<double>(now - updatedAt) / AV_TIME_BASE;
+    }
+    updatedAt   = now;
+    isPaused    = paused;
+    SDL_UnlockMutex(mutex);
+}
@@ -0,0 +1,32 @@
+#ifndef MEDIACLOCK_H
+#define MEDIACLOCK_H
+
+#include <QtGlobal>
+
+#include "SDL2/SDL.h"
+
+/* 按单调时钟走时的播放时钟
+ * 记录（pts，设置时刻），读取时按经过的时间外推，暂停时停住。
+ * 用作视频时钟（每显示一帧设置一次）和外部时钟（只在开始播放和跳转时设置）。
+ */
+class MediaClock
+{
+public:
+    MediaClock();
+    ~MediaClock();
+
+    double get();
+
+    void set(double pts);
+
+    void setPaused(bool paused);
+
+private:
+    double pts;             // 设置时的时间（秒）
+    qint64 updatedAt;       // 设置时刻（av_gettime_relative，微秒）
+    bool isPaused;
+
+    SDL_mutex *mutex;
+};
+
+#endif // MEDIACLOCK_H
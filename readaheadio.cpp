@@ -0,0 +1,352 @@
+﻿#include <QFileInfo>
+#include <QDebug>
+
+extern "C"
+{
+#include "libavutil/time.h"
+}
+
+#include "readaheadio.h"
+#include "tracer.h"
+
+/* 交给解复用器的 AVIOContext 缓冲区大小 */
+#define READ_AHEAD_IO_BUFFER    (64 * 1024)
+/* 后台线程每次读取的最大字节数 */
+#define READ_AHEAD_CHUNK        (256 * 1024)
+/* 等待数据时检查中断回调的间隔（毫秒） */
+#define READ_AHEAD_POLL_MS      10
+
+ReadAheadIO::ReadAheadIO() :
+    source(nullptr),
+    ioCtx(nullptr),
+    fileSize(-1),
+    ring(nullptr),
+    capacity(0),
+    head(0),
+    count(0),
+    readOffset(0),
+    seekOffset(-1),
+    generation(0),
+    isEof(false),
+    error(0),
+    tid(nullptr),
+    isAbort(0)
+{
+    memset(&interruptCb, 0, sizeof(interruptCb));
+    memset(&stats, 0, sizeof(stats));
+
+    mutex       = SDL_CreateMutex();
+    dataCond    = SDL_CreateCond();
+    spaceCond   = SDL_CreateCond();
+}
+
+ReadAheadIO::~ReadAheadIO()
+{
+    close();
+
+    SDL_DestroyCond(spaceCond);
+    SDL_DestroyCond(dataCond);
+    SDL_DestroyMutex(mutex);
+}
+
+// 只对本地文件（包括挂载的网络盘）预读，网络协议由 FFmpeg 自己缓冲
+bool ReadAheadIO::isUseful(const QString &file)
+{
+    return QFileInfo(file).isFile();
+}
+
+/**
+ * @brief 打开文件并启动预读线程
+ * @param file        本地文件路径
+ * @param interruptCb 解复用器的中断回调，等待数据和底层读取时检查
+ * @param bufferSize  环形缓冲区大小（字节）
+ * @return 赋给 AVFormatContext::pb 的上下文，失败时返回 nullptr；由 close() 释放
+ */
+AVIOContext *ReadAheadIO::open(const QString &file, const AVIOInterruptCB *interruptCb, int bufferSize)
+{
+    uint8_t *ioBuffer;
+
+    close();
+
+    this->interruptCb = *interruptCb;
+
+    if (avio_open2(&source, file.toLocal8Bit().data(), AVIO_FLAG_READ, interruptCb, NULL) < 0) {
+        qDebug() << "Read-ahead open failed:" << file;
+        return nullptr;
+    }
+
+    capacity    = FFMAX(bufferSize, READ_AHEAD_CHUNK);
+    ring        = static_cast<uint8_t *>(av_malloc(capacity));
+    ioBuffer    = static_cast<uint8_t *>(av_malloc(READ_AHEAD_IO_BUFFER));
+    if (!ring || !ioBuffer) {
+        av_free(ioBuffer);
+        close();
+        return nullptr;
+    }
+
+    ioCtx = avio_alloc_context(ioBuffer, READ_AHEAD_IO_BUFFER, 0, this,
+                               &ReadAheadIO::readPacket, NULL, &ReadAheadIO::seek);
+    if (!ioCtx) {
+        av_free(ioBuffer);
+        close();
+        return nullptr;
+    }
+
+    SDL_LockMutex(mutex);
+    fileSize    = avio_size(source);
+    head        = 0;
+    count       = 0;
+    readOffset  = 0;
+    seekOffset  = -1;
+    isEof       = false;
+    error       = 0;
+
+    memset(&stats, 0, sizeof(stats));
+    stats.bufferSize = capacity;
+    SDL_UnlockMutex(mutex);
+
+    isAbort = 0;
+    tid = SDL_CreateThread(&ReadAheadIO::readThread, "read_ahead", this);
+
+    return ioCtx;
+}
+
+// 停止预读线程并释放上下文，需在 avformat_close_input() 之后调用；统计保留到下次打开
+void ReadAheadIO::close()
+{
+    isAbort = 1;
+
+    if (tid) {
+        SDL_LockMutex(mutex);
+        SDL_CondSignal(spaceCond);
+        SDL_UnlockMutex(mutex);
+
+        SDL_WaitThread(tid, NULL);
+        tid = nullptr;
+    }
+
+    if (ioCtx) {
+        // 缓冲区可能被 FFmpeg 重新分配过，释放上下文中当前的缓冲区
+        av_freep(&ioCtx->buffer);
+        avio_context_free(&ioCtx);
+    }
+
+    avio_closep(&source);
+    av_freep(&ring);
+
+    SDL_LockMutex(mutex);
+    capacity            = 0;
+    count               = 0;
+    stats.buffered      = 0;
+    stats.bufferSize    = 0;
+    SDL_UnlockMutex(mutex);
+}
+
+ReadAheadIO::Stats ReadAheadIO::getStats()
+{
+    Stats current;
+
+    SDL_LockMutex(mutex);
+    current = stats;
+    current.buffered = count;
+    SDL_UnlockMutex(mutex);
+
+    return current;
+}
+
+int ReadAheadIO::readThread(void *arg)
+{
+    ReadAheadIO *io = (ReadAheadIO *)arg;
+
+    TRACE_THREAD_NAME("read_ahead");
+
+    io->fill();
+
+    return 0;
+}
+
+/**
+ * @brief 预读循环（预读线程）：缓冲区有空间时从文件顺序读取，读取时不持有锁
+ * @note  读取期间解复用线程清空了缓冲区（跳转）时，按 generation 丢弃这次读到的数据
+ */
+void ReadAheadIO::fill()
+{
+    SDL_LockMutex(mutex);
+
+    while (!isAbort) {
+        if (seekOffset >= 0) {
+            qint64 target = seekOffset;
+            int seekGeneration = generation;
+
+            seekOffset = -1;
+            SDL_UnlockMutex(mutex);
+
+            int64_t ret = avio_seek(source, target, SEEK_SET);
+
+            SDL_LockMutex(mutex);
+            if (seekGeneration == generation && ret < 0) {
+                error = static_cast<int>(ret);
+                SDL_CondSignal(dataCond);
+            }
+            continue;
+        }
+
+        if (isEof || error || count == capacity) {
+            SDL_CondWait(spaceCond, mutex);
+            continue;
+        }
+
+        // 只读到环形缓冲区末尾，绕回的部分下次再读
+        int tail = (head + count) % capacity;
+        int size = FFMIN(FFMIN(capacity - count, capacity - tail), READ_AHEAD_CHUNK);
+        int readGeneration = generation;
+        qint64 start = av_gettime_relative();
+
+        SDL_UnlockMutex(mutex);
+
+        int ret;
+        {
+            TRACE_SCOPE("read_ahead");
+            ret = avio_read(source, ring + tail, size);
+        }
+
+        SDL_LockMutex(mutex);
+
+        stats.readTime += av_gettime_relative() - start;
+
+        if (readGeneration != generation) {
+            continue;
+        }
+
+        if (ret > 0) {
+            count += ret;
+            stats.bytesRead += ret;
+        } else if (ret == 0 || ret == AVERROR_EOF) {
+            isEof = true;
+        } else {
+            error = ret;
+        }
+        SDL_CondSignal(dataCond);
+    }
+
+    SDL_UnlockMutex(mutex);
+}
+
+int ReadAheadIO::readPacket(void *opaque, uint8_t *buf, int bufSize)
+{
+    return static_cast<ReadAheadIO *>(opaque)->read(buf, bufSize);
+}
+
+int64_t ReadAheadIO::seek(void *opaque, int64_t offset, int whence)
+{
+    return static_cast<ReadAheadIO *>(opaque)->seekTo(offset, whence);
+}
+
+/**
+ * @brief 从缓冲区读取（解复用线程），缓冲区为空时等待预读线程，记为一次停顿
+ * @note  等待期间检查解复用器的中断回调，停止/打开命令可以打断等待
+ */
+int ReadAheadIO::read(uint8_t *buf, int bufSize)
+{
+    qint64 stallStart = 0;
+    int ret;
+
+    SDL_LockMutex(mutex);
+
+    while (count == 0 && !isEof && !error && !isAbort) {
+        if (interruptCb.callback && interruptCb.callback(interruptCb.opaque)) {
+            break;
+        }
+
+        if (!stallStart) {
+            stallStart = av_gettime_relative();
+            stats.stalls++;
+        }
+        SDL_CondWaitTimeout(dataCond, mutex, READ_AHEAD_POLL_MS);
+    }
+
+    if (stallStart) {
+        stats.stallTime += av_gettime_relative() - stallStart;
+    }
+
+    if (count > 0) {
+        // 数据可能绕过缓冲区末尾，分两段拷贝
+        int size = FFMIN(bufSize, count);
+        int first = FFMIN(size, capacity - head);
+
+        memcpy(buf, ring + head, first);
+        memcpy(buf + first, ring, size - first);
+
+        head        = (head + size) % capacity;
+        count      -= size;
+        readOffset += size;
+        ret         = size;
+
+        SDL_CondSignal(spaceCond);
+    } else if (error) {
+        ret = error;
+    } else if (isEof) {
+        ret = AVERROR_EOF;
+    } else {
+        ret = AVERROR_EXIT;
+    }
+
+    SDL_UnlockMutex(mutex);
+
+    return ret;
+}
+
+/**
+ * @brief 跳转（解复用线程）：目标在已预读的范围内时丢弃之前的数据，否则清空缓冲区从目标位置重新预读
+ */
+int64_t ReadAheadIO::seekTo(int64_t offset, int whence)
+{
+    int64_t target;
+
+    if (whence == AVSEEK_SIZE) {
+        return fileSize;
+    }
+
+    SDL_LockMutex(mutex);
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case SEEK_SET:
+        target = offset;
+        break;
+    case SEEK_CUR:
+        target = readOffset + offset;
+        break;
+    case SEEK_END:
+        target = fileSize >= 0 ? fileSize + offset : -1;
+        break;
+    default:
+        target = -1;
+        break;
+    }
+
+    if (target < 0) {
+        SDL_UnlockMutex(mutex);
+        return AVERROR(EINVAL);
+    }
+
+    if (target >= readOffset && target <= readOffset + count) {
+        int skip = static_cast<int>(target - readOffset);
+
+        head    = (head + skip) % capacity;
+        count  -= skip;
+    } else {
+        generation++;
+        head        = 0;
+        count       = 0;
+        isEof       = false;
+        error       = 0;
+        seekOffset  = target;
+        stats.seeks++;
+    }
+    readOffset = target;
+
+    SDL_CondSignal(spaceCond);
+    SDL_UnlockMutex(mutex);
+
+    return target;
+}
@@ -0,0 +1,76 @@
+#ifndef READAHEADIO_H
+#define READAHEADIO_H
+
+#include <QString>
+#include <QAtomicInt>
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+}
+
+#include "SDL2/SDL.h"
+
+/* 默认预读缓冲区大小（字节） */
+#define READ_AHEAD_DEFAULT_SIZE (16 * 1024 * 1024)
+
+/* 预读 I/O：解复用使用的自定义 AVIOContext，后台线程按顺序从文件读取数据放入环形缓冲区，
+ * av_read_frame 只从缓冲区拷贝，不再直接等待网络挂载盘或机械硬盘的 I/O。
+ *
+ * 跳转目标在缓冲区内时丢弃之前的数据继续使用，否则清空缓冲区并让后台线程从新位置开始读取
+ */
+class ReadAheadIO
+{
+public:
+    struct Stats {
+        qint64 bytesRead;       // 后台线程从文件读取的字节数
+        qint64 readTime;        // 后台线程在读取上花费的时间（微秒）
+        qint64 stalls;          // 解复用时缓冲区为空、需要等待的次数
+        qint64 stallTime;       // 解复用等待数据的总时间（微秒）
+        qint64 seeks;           // 清空缓冲区的跳转次数
+        qint64 buffered;        // 缓冲区中的数据量
+        int bufferSize;         // 缓冲区大小，0 表示没有使用预读
+    };
+
+    ReadAheadIO();
+    ~ReadAheadIO();
+
+    static bool isUseful(const QString &file);
+
+    AVIOContext *open(const QString &file, const AVIOInterruptCB *interruptCb, int bufferSize);
+    void close();
+    Stats getStats();
+
+private:
+    static int readThread(void *arg);
+    static int readPacket(void *opaque, uint8_t *buf, int bufSize);
+    static int64_t seek(void *opaque, int64_t offset, int whence);
+    void fill();
+    int read(uint8_t *buf, int bufSize);
+    int64_t seekTo(int64_t offset, int whence);
+
+    AVIOContext *source;        // 底层文件
+    AVIOContext *ioCtx;         // 交给解复用器的上下文
+    AVIOInterruptCB interruptCb;
+    qint64 fileSize;
+
+    /* 环形缓冲区和读取状态，由 mutex 保护 */
+    uint8_t *ring;
+    int capacity;
+    int head;                   // 下一个要交给解复用器的字节
+    int count;                  // 缓冲区中的字节数
+    qint64 readOffset;          // head 对应的文件位置
+    qint64 seekOffset;          // 后台线程需要跳转到的位置，-1 表示没有
+    int generation;             // 每次清空缓冲区加一，丢弃清空之前发起的读取结果
+    bool isEof;
+    int error;                  // 底层读取的错误码
+    Stats stats;
+    SDL_mutex *mutex;
+    SDL_cond *dataCond;         // 缓冲区有数据、到达文件尾或出错
+    SDL_cond *spaceCond;        // 缓冲区有空间或需要跳转
+
+    SDL_Thread *tid;            // 预读线程
+    QAtomicInt isAbort;
+};
+
+#endif // READAHEADIO_H
@@ -0,0 +1,45 @@
+﻿#include "stagecounter.h"
+
+StageCounter::StageCounter() :
+    calls(0),
+    total(0),
+    maxTime(0)
+{
+
+}
+
+// 记录一次耗时（微秒），任意线程调用
+void StageCounter::add(qint64 time)
+{
+    calls.fetchAndAddRelaxed(1);
+    total.fetchAndAddRelaxed(time);
+
+    // 只有超过当前最大值时才写入，通常只是一次读取
+    qint64 current = maxTime.loadAcquire();
+    while (time > current && !maxTime.testAndSetOrdered(current, time, current)) {
+    }
+}
+
+qint64 StageCounter::count()
+{
+    return calls.loadAcquire();
+}
+
+qint64 StageCounter::totalTime()
+{
+    return total.loadAcquire();
+}
+
+// 取出上次读取以来的最大耗时并清零，只应有一个读取者
+qint64 StageCounter::takeMaxTime()
+{
+    return maxTime.fetchAndStoreOrdered(0);
+}
+
+// 开始播放新文件时清零
+void StageCounter::reset()
+{
+    calls.storeRelease(0);
+    total.storeRelease(0);
+    maxTime.storeRelease(0);
+}
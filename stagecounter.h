@@ -0,0 +1,31 @@
+#ifndef STAGECOUNTER_H
+#define STAGECOUNTER_H
+
+#include <QAtomicInteger>
+
+/* 播放管线中单个阶段（读包、解码、滤镜、绘制）的耗时计数器
+ * 工作线程每次只做几次原子累加，不加锁，可以一直开启；
+ * 读取者（如界面上的统计面板）按两次读取的差值计算这段时间内的平均耗时。
+ */
+class StageCounter
+{
+public:
+    StageCounter();
+
+    void add(qint64 time);
+
+    qint64 count();
+
+    qint64 totalTime();
+
+    qint64 takeMaxTime();
+
+    void reset();
+
+private:
+    QAtomicInteger<qint64> calls;       // 累计次数
+    QAtomicInteger<qint64> total;       // 累计耗时（微秒）
+    QAtomicInteger<qint64> maxTime;     // 上次读取以来的最大耗时（微秒）
+};
+
+#endif // STAGECOUNTER_H
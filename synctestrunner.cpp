@@ -0,0 +1,677 @@
+﻿#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+#include <algorithm>
+#include <math.h>
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+#include "libavfilter/avfilter.h"
+#include "libavutil/parseutils.h"
+}
+
+#include "synctestrunner.h"
+#include "tracer.h"
+
+/* 测试片段：每秒的 SYNC_EVENT_OFFSET 秒处闪白并响一次提示音，关键帧在整秒处，
+ * 跳转到整秒时落在两次事件之间
+ */
+#define SYNC_CLIP_SECONDS       16
+#define SYNC_EVENT_OFFSET       0.5
+#define SYNC_EVENT_LENGTH       0.1         // 闪白和提示音的持续时间（秒）
+#define SYNC_VIDEO_WIDTH        320
+#define SYNC_VIDEO_HEIGHT       240
+#define SYNC_AUDIO_RATE         48000
+#define SYNC_AUDIO_FRAME        1024        // 每个音频包的采样数
+#define SYNC_BEEP_FREQ          1000        // 提示音频率（Hz）
+#define SYNC_BEEP_LEVEL         0.5         // 提示音幅度（满幅的比例）
+
+/* 检测与配对 */
+#define SYNC_BEEP_THRESHOLD     0.05        // 超过满幅的该比例视为有声
+#define SYNC_BEEP_GAP           50000       // 静音超过该时长（微秒）后再出现声音才算新的提示音
+#define SYNC_MATCH_WINDOW       400000      // 闪白与提示音相差超过该值（微秒）视为没有配对
+#define SYNC_ACTION_DELAY       400         // 闪白之后多久执行暂停/跳转（毫秒），落在两次事件之间
+#define SYNC_PAUSE_TIME         1000        // 暂停时长（毫秒）
+#define SYNC_SEEK_BACKWARD      2           // 第 6 次闪白后跳回的位置（秒）
+#define SYNC_SEEK_FORWARD       12          // 第 9 次闪白后跳到的位置（秒）
+#define SYNC_CLIP_TIMEOUT       (SYNC_CLIP_SECONDS * 3 * 1000)
+
+/* 误差直方图（毫秒），超出范围的计入两端 */
+#define SYNC_HISTOGRAM_BIN      5
+#define SYNC_HISTOGRAM_RANGE    100
+
+// 第 k 次事件所在的视频帧序号
+static qint64 eventFrame(int k, AVRational frameRate)
+{
+    return llrint((k + SYNC_EVENT_OFFSET) * av_q2d(frameRate));
+}
+
+// 编码一帧（frame 为 NULL 时冲刷编码器），取出的包写入文件
+static bool encodeFrame(AVFormatContext *formatCtx, AVCodecContext *codecCtx, AVStream *stream, AVFrame *frame)
+{
+    AVPacket packet;
+    int ret;
+
+    if (avcodec_send_frame(codecCtx, frame) < 0) {
+        return false;
+    }
+
+    av_init_packet(&packet);
+    packet.data = NULL;
+    packet.size = 0;
+
+    while ((ret = avcodec_receive_packet(codecCtx, &packet)) >= 0) {
+        av_packet_rescale_ts(&packet, codecCtx->time_base, stream->time_base);
+        packet.stream_index = stream->index;
+
+        // av_interleaved_write_frame 接管包的引用
+        if (av_interleaved_write_frame(formatCtx, &packet) < 0) {
+            return false;
+        }
+    }
+
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
+}
+
+/**
+ * @brief 生成同步测试片段：黑底 MPEG-4 视频 + 静音 PCM 音频，
+ *        事件处的视频帧为白色，音频从该帧的时间戳开始响 SYNC_BEEP_FREQ 的正弦波
+ */
+static bool writeSyncClip(const QString &file, AVRational frameRate)
+{
+    AVFormatContext *formatCtx = NULL;
+    AVCodecContext *videoCtx = NULL;
+    AVCodecContext *audioCtx = NULL;
+    AVStream *videoStream = NULL;
+    AVStream *audioStream = NULL;
+    AVFrame *videoFrame = NULL;
+    AVFrame *audioFrame = NULL;
+    AVCodec *videoCodec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    AVCodec *audioCodec = avcodec_find_encoder(AV_CODEC_ID_PCM_S16LE);
+    QByteArray path = file.toLocal8Bit();
+    qint64 videoFrames = llrint(SYNC_CLIP_SECONDS * av_q2d(frameRate));
+    qint64 audioSamples = static_cast<qint64>(SYNC_CLIP_SECONDS) * SYNC_AUDIO_RATE;
+    qint64 flashFrames = FFMAX(2, llrint(SYNC_EVENT_LENGTH * av_q2d(frameRate)));
+    qint64 beepSamples = llrint(SYNC_EVENT_LENGTH * SYNC_AUDIO_RATE);
+    QVector<qint64> flashStarts;
+    QVector<qint64> beepStarts;
+    qint64 videoPts = 0;
+    qint64 audioPts = 0;
+    bool ok = false;
+
+    if (!videoCodec || !audioCodec) {
+        qDebug() << "Sync test: MPEG-4 or PCM encoder not available";
+        return false;
+    }
+
+    // 提示音从闪白帧的时间戳开始，理想情况下两者误差为 0
+    for (int k = 0; k < SYNC_CLIP_SECONDS; k++) {
+        qint64 frame = eventFrame(k, frameRate);
+        flashStarts.append(frame);
+        beepStarts.append(av_rescale_q(frame, av_inv_q(frameRate), AVRational{1, SYNC_AUDIO_RATE}));
+    }
+
+    if (avformat_alloc_output_context2(&formatCtx, NULL, "matroska", path.data()) < 0) {
+        return false;
+    }
+
+    videoCtx = avcodec_alloc_context3(videoCodec);
+    videoCtx->width         = SYNC_VIDEO_WIDTH;
+    videoCtx->height        = SYNC_VIDEO_HEIGHT;
+    videoCtx->pix_fmt       = AV_PIX_FMT_YUV420P;
+    videoCtx->time_base     = av_inv_q(frameRate);
+    videoCtx->framerate     = frameRate;
+    videoCtx->gop_size      = 600;      // 关键帧由每秒第一帧强制产生
+
+    audioCtx = avcodec_alloc_context3(audioCodec);
+    audioCtx->sample_fmt        = AV_SAMPLE_FMT_S16;
+    audioCtx->sample_rate       = SYNC_AUDIO_RATE;
+    audioCtx->channel_layout    = AV_CH_LAYOUT_MONO;
+    audioCtx->channels          = 1;
+    audioCtx->time_base         = AVRational{1, SYNC_AUDIO_RATE};
+
+    if (formatCtx->oformat->flags & AVFMT_GLOBALHEADER) {
+        videoCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        audioCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (avcodec_open2(videoCtx, videoCodec, NULL) < 0 || avcodec_open2(audioCtx, audioCodec, NULL) < 0) {
+        qDebug() << "Sync test: open encoder failed";
+        goto out;
+    }
+
+    videoStream = avformat_new_stream(formatCtx, NULL);
+    audioStream = avformat_new_stream(formatCtx, NULL);
+    avcodec_parameters_from_context(videoStream->codecpar, videoCtx);
+    avcodec_parameters_from_context(audioStream->codecpar, audioCtx);
+    videoStream->time_base      = videoCtx->time_base;
+    videoStream->avg_frame_rate = frameRate;
+    audioStream->time_base      = audioCtx->time_base;
+
+    if (avio_open(&formatCtx->pb, path.data(), AVIO_FLAG_WRITE) < 0 || avformat_write_header(formatCtx, NULL) < 0) {
+        qDebug() << "Sync test: write header failed" << file;
+        goto out;
+    }
+
+    videoFrame = av_frame_alloc();
+    videoFrame->format  = AV_PIX_FMT_YUV420P;
+    videoFrame->width   = SYNC_VIDEO_WIDTH;
+    videoFrame->height  = SYNC_VIDEO_HEIGHT;
+    av_frame_get_buffer(videoFrame, 32);
+
+    audioFrame = av_frame_alloc();
+    audioFrame->format          = AV_SAMPLE_FMT_S16;
+    audioFrame->channel_layout  = AV_CH_LAYOUT_MONO;
+    audioFrame->sample_rate     = SYNC_AUDIO_RATE;
+    audioFrame->nb_samples      = SYNC_AUDIO_FRAME;
+    av_frame_get_buffer(audioFrame, 0);
+
+    // 按时间戳交织写入音视频
+    while (videoPts < videoFrames || audioPts < audioSamples) {
+        bool isVideo = audioPts >= audioSamples
+                || (videoPts < videoFrames
+                    && av_compare_ts(videoPts, videoCtx->time_base, audioPts, audioCtx->time_base) <= 0);
+
+        if (isVideo) {
+            bool isWhite = false;
+            for (int k = 0; k < flashStarts.size(); k++) {
+                if (videoPts >= flashStarts[k] && videoPts < flashStarts[k] + flashFrames) {
+                    isWhite = true;
+                }
+            }
+
+            av_frame_make_writable(videoFrame);
+            memset(videoFrame->data[0], isWhite ? 235 : 16, videoFrame->linesize[0] * SYNC_VIDEO_HEIGHT);
+            memset(videoFrame->data[1], 128, videoFrame->linesize[1] * SYNC_VIDEO_HEIGHT / 2);
+            memset(videoFrame->data[2], 128, videoFrame->linesize[2] * SYNC_VIDEO_HEIGHT / 2);
+
+            // 每秒的第一帧为关键帧，跳转到整秒时从这里开始解码
+            bool isKey = videoPts == 0
+                    || av_rescale_rnd(videoPts, videoCtx->time_base.num, videoCtx->time_base.den, AV_ROUND_DOWN)
+                    != av_rescale_rnd(videoPts - 1, videoCtx->time_base.num, videoCtx->time_base.den, AV_ROUND_DOWN);
+            videoFrame->pict_type   = isKey ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+            videoFrame->pts         = videoPts++;
+
+            if (!encodeFrame(formatCtx, videoCtx, videoStream, videoFrame)) {
+                goto out;
+            }
+        } else {
+            qint16 *samples;
+
+            av_frame_make_writable(audioFrame);
+            audioFrame->nb_samples = static_cast<int>(FFMIN(SYNC_AUDIO_FRAME, audioSamples - audioPts));
+            samples = reinterpret_cast<qint16 *>(audioFrame->data[0]);
+
+            for (int i = 0; i < audioFrame->nb_samples; i++) {
+                qint64 position = audioPts + i;
+                double value = 0;
+
+                for (int k = 0; k < beepStarts.size(); k++) {
+                    if (position >= beepStarts[k] && position < beepStarts[k] + beepSamples) {
+                        value = SYNC_BEEP_LEVEL * sin(2 * M_PI * SYNC_BEEP_FREQ * (position - beepStarts[k]) / SYNC_AUDIO_RATE);
+                    }
+                }
+
+                samples[i] = static_cast<qint16>(value * 32767);
+            }
+
+            audioFrame->pts = audioPts;
+            audioPts += audioFrame->nb_samples;
+
+            if (!encodeFrame(formatCtx, audioCtx, audioStream, audioFrame)) {
+                goto out;
+            }
+        }
+    }
+
+    if (!encodeFrame(formatCtx, videoCtx, videoStream, NULL) || !encodeFrame(formatCtx, audioCtx, audioStream, NULL)) {
+        goto out;
+    }
+
+    ok = av_write_trailer(formatCtx) == 0;
+
+out:
+    av_frame_free(&videoFrame);
+    av_frame_free(&audioFrame);
+    avcodec_free_context(&videoCtx);
+    avcodec_free_context(&audioCtx);
+    if (formatCtx->pb) {
+        avio_closep(&formatCtx->pb);
+    }
+    avformat_free_context(formatCtx);
+
+    return ok;
+}
+
+SyncTestRunner::SyncTestRunner(const QList<AVRational> &frameRates, double tolerance, QObject *parent) :
+    QObject(parent),
+    decoder(new MainDecoder),
+    frameRates(frameRates),
+    tolerance(tolerance),
+    clipIndex(0),
+    isStopping(false),
+    isTimedOut(false),
+    pendingAction(ACTION_NONE),
+    beepCount(0),
+    lastLoudTime(0),
+    isFlashing(false),
+    unmatched(0)
+{
+    actionTimer.setSingleShot(true);
+    watchdog.setSingleShot(true);
+
+    decoder->setAudioOutputTap(&SyncTestRunner::audioTap, this);
+
+    // 与无界面模式一样使用旁路滤镜，默认的 pp 滤镜耗时不固定，会混进同步误差
+    decoder->setVideoFilter(QString());
+
+    connect(decoder, &MainDecoder::gotVideo,            this, &SyncTestRunner::takeVideo);
+    connect(decoder, &MainDecoder::playStateChanged,    this, &SyncTestRunner::playStateChanged);
+    connect(&actionTimer, &QTimer::timeout,             this, &SyncTestRunner::runAction);
+    connect(&watchdog, &QTimer::timeout,                this, &SyncTestRunner::timeout);
+}
+
+SyncTestRunner::~SyncTestRunner()
+{
+    decoder->setAudioOutputTap(nullptr, nullptr);
+    delete decoder;
+}
+
+// 生成所有帧率的测试片段
+bool SyncTestRunner::prepare()
+{
+    if (!clipDir.isValid()) {
+        return false;
+    }
+
+    for (int i = 0; i < frameRates.size(); i++) {
+        QString file = clipDir.filePath(QString("sync_%1_%2.mkv").arg(frameRates[i].num).arg(frameRates[i].den));
+
+        if (!writeSyncClip(file, frameRates[i])) {
+            qDebug() << "Sync test: generate clip failed" << file;
+            return false;
+        }
+
+        clipFiles.append(file);
+    }
+
+    return true;
+}
+
+void SyncTestRunner::setOutputFile(const QString &file)
+{
+    outputFile = file;
+}
+
+void SyncTestRunner::start()
+{
+    clipIndex = 0;
+    startClip();
+}
+
+// 开始播放一个片段，此时音频设备已关闭，可以直接重置音频线程的检测状态
+void SyncTestRunner::startClip()
+{
+    beepCount       = 0;
+    lastLoudTime    = 0;
+    flashOnsets.clear();
+    isFlashing      = false;
+    isStopping      = false;
+    isTimedOut      = false;
+    pendingAction   = ACTION_NONE;
+
+    watchdog.start(SYNC_CLIP_TIMEOUT);
+    decoder->decoderFile(clipFiles[clipIndex], "video");
+}
+
+/**
+ * @brief 视频输出：像界面一样从信箱取帧，画面中心由暗变亮即为闪白起点，记录取帧时刻
+ * @note  在第 3、6、9 次闪白之后分别暂停、向后跳转、向前跳转
+ */
+void SyncTestRunner::takeVideo()
+{
+    if (!decoder->takeVideoFrame(&image) || image.isNull()) {
+        return;
+    }
+
+    qint64 now = av_gettime_relative();
+    bool isWhite = qGray(image.pixel(image.width() / 2, image.height() / 2)) > 128;
+    image = QImage();
+
+    if (isWhite && !isFlashing && !isStopping) {
+        flashOnsets.append(now);
+
+        switch (flashOnsets.size()) {
+        case 3: pendingAction = ACTION_PAUSE;           break;
+        case 6: pendingAction = ACTION_SEEK_BACKWARD;   break;
+        case 9: pendingAction = ACTION_SEEK_FORWARD;    break;
+        default: break;
+        }
+
+        if (pendingAction != ACTION_NONE) {
+            actionTimer.start(SYNC_ACTION_DELAY);
+        }
+    }
+
+    isFlashing = isWhite;
+}
+
+void SyncTestRunner::runAction()
+{
+    if (isStopping) {
+        return;
+    }
+
+    switch (pendingAction) {
+    case ACTION_PAUSE:
+        decoder->pauseVideo();
+        pendingAction = ACTION_RESUME;
+        actionTimer.start(SYNC_PAUSE_TIME);
+        return;
+
+    case ACTION_RESUME:
+        decoder->pauseVideo();
+        break;
+
+    case ACTION_SEEK_BACKWARD:
+        decoder->seekProgress(static_cast<qint64>(SYNC_SEEK_BACKWARD) * AV_TIME_BASE);
+        break;
+
+    case ACTION_SEEK_FORWARD:
+        decoder->seekProgress(static_cast<qint64>(SYNC_SEEK_FORWARD) * AV_TIME_BASE);
+        break;
+
+    default:
+        break;
+    }
+
+    pendingAction = ACTION_NONE;
+}
+
+void SyncTestRunner::timeout()
+{
+    qDebug() << "Sync test: clip timed out" << clipFiles[clipIndex];
+    isTimedOut = true;
+    isStopping = true;
+    actionTimer.stop();
+    decoder->stopVideo();
+}
+
+void SyncTestRunner::playStateChanged(MainDecoder::PlayState state)
+{
+    switch (state) {
+    case MainDecoder::FINISH:
+        isStopping = true;
+        actionTimer.stop();
+        watchdog.stop();
+        decoder->stopVideo();
+        break;
+
+    case MainDecoder::STOP:
+        // 停止后音频设备已关闭，提示音记录不再变化
+        if (isStopping) {
+            finishClip();
+
+            if (++clipIndex < clipFiles.size()) {
+                startClip();
+                break;
+            }
+
+            QJsonObject result = report();
+            QByteArray json = QJsonDocument(result).toJson();
+
+            if (outputFile.isEmpty()) {
+                QTextStream(stdout) << json;
+            } else {
+                QFile output(outputFile);
+                if (output.open(QFile::WriteOnly | QFile::Truncate)) {
+                    output.write(json);
+                } else {
+                    qDebug() << "Open report file failed:" << outputFile;
+                }
+            }
+
+            QCoreApplication::exit(result["passed"].toBool() ? 0 : 2);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void SyncTestRunner::audioTap(void *opaque, const SDL_AudioSpec *spec, const quint8 *data, int size, qint64 callbackTime)
+{
+    static_cast<SyncTestRunner *>(opaque)->detectBeeps(spec, data, size, callbackTime);
+}
+
+/**
+ * @brief 在音频线程中检测提示音起点：只看第一个声道，静音超过 SYNC_BEEP_GAP 后的第一个有声采样
+ * @note  输出时刻不使用音频时钟的延迟模型，只按回调时刻加上实际打开的设备缓冲区时长（spec->samples）独立推算，
+ *        否则测试只是在拿模型和它自己比较。起点写入预分配的数组再发布计数，不加锁、不分配内存
+ */
+void SyncTestRunner::detectBeeps(const SDL_AudioSpec *spec, const quint8 *data, int size, qint64 callbackTime)
+{
+    int sampleSize = SDL_AUDIO_BITSIZE(spec->format) / 8;
+    int frameSize = sampleSize * spec->channels;
+    int frames = size / frameSize;
+    // 本次数据排在设备缓冲区中的一个周期之后开始播放
+    qint64 playTime = callbackTime + static_cast<qint64>(spec->samples) * AV_TIME_BASE / spec->freq;
+
+    for (int i = 0; i < frames; i++) {
+        const quint8 *sample = data + i * frameSize;
+        double level;
+
+        switch (spec->format) {
+        case AUDIO_F32SYS: level = *reinterpret_cast<const float *>(sample);                break;
+        case AUDIO_S32SYS: level = *reinterpret_cast<const qint32 *>(sample) / 2147483648.0; break;
+        case AUDIO_S16SYS: level = *reinterpret_cast<const qint16 *>(sample) / 32768.0;      break;
+        default:           level = (*sample - 128) / 128.0;                                 break;
+        }
+
+        if (fabs(level) < SYNC_BEEP_THRESHOLD) {
+            continue;
+        }
+
+        qint64 time = playTime + static_cast<qint64>(i) * AV_TIME_BASE / spec->freq;
+        int count = beepCount.loadAcquire();
+
+        if (time - lastLoudTime > SYNC_BEEP_GAP && count < SYNC_MAX_ONSETS) {
+            beepOnsets[count] = time;
+            beepCount.storeRelease(count + 1);
+        }
+
+        lastLoudTime = time;
+    }
+}
+
+/**
+ * @brief 片段结束：每个闪白与时间最接近且未使用的提示音配对，
+ *        相差超过 SYNC_MATCH_WINDOW 或找不到的计为未配对
+ */
+void SyncTestRunner::finishClip()
+{
+    AVRational rate = frameRates[clipIndex];
+    QVector<qint64> beeps;
+    QVector<bool> isUsed;
+    QVector<double> clipErrors;
+    QJsonObject clip;
+    int unmatchedFlashes = 0;
+    int unmatchedBeeps = 0;
+    double sum = 0, squareSum = 0, maxError = 0;
+
+    for (int i = 0; i < beepCount.loadAcquire(); i++) {
+        beeps.append(beepOnsets[i]);
+    }
+    isUsed.fill(false, beeps.size());
+
+    for (int i = 0; i < flashOnsets.size(); i++) {
+        int best = -1;
+
+        for (int j = 0; j < beeps.size(); j++) {
+            if (!isUsed[j] && (best < 0 || qAbs(flashOnsets[i] - beeps[j]) < qAbs(flashOnsets[i] - beeps[best]))) {
+                best = j;
+            }
+        }
+
+        if (best < 0 || qAbs(flashOnsets[i] - beeps[best]) > SYNC_MATCH_WINDOW) {
+            unmatchedFlashes++;
+            continue;
+        }
+
+        isUsed[best] = true;
+        clipErrors.append((flashOnsets[i] - beeps[best]) / 1000.0);
+    }
+
+    unmatchedBeeps = isUsed.count(false);
+
+    for (int i = 0; i < clipErrors.size(); i++) {
+        sum         += clipErrors[i];
+        squareSum   += clipErrors[i] * clipErrors[i];
+        maxError    = qMax(maxError, fabs(clipErrors[i]));
+    }
+
+    double mean = clipErrors.isEmpty() ? 0 : sum / clipErrors.size();
+
+    clip["frame_rate"]          = QString("%1/%2").arg(rate.num).arg(rate.den);
+    clip["matched"]             = clipErrors.size();
+    clip["unmatched_flashes"]   = unmatchedFlashes;
+    clip["unmatched_beeps"]     = unmatchedBeeps;
+    clip["mean_ms"]             = mean;
+    clip["stddev_ms"]           = clipErrors.isEmpty() ? 0 : sqrt(qMax(0.0, squareSum / clipErrors.size() - mean * mean));
+    clip["max_abs_ms"]          = maxError;
+    clip["timed_out"]           = isTimedOut;
+
+    clipReports.append(clip);
+    errors      += clipErrors;
+    unmatched   += unmatchedFlashes + unmatchedBeeps + (isTimedOut ? 1 : 0);
+}
+
+QJsonObject SyncTestRunner::report()
+{
+    QJsonObject result;
+    QJsonObject histogram;
+    QJsonArray counts;
+    QVector<double> absErrors;
+    QVector<int> bins(2 * SYNC_HISTOGRAM_RANGE / SYNC_HISTOGRAM_BIN, 0);
+    int underflow = 0, overflow = 0;
+
+    for (int i = 0; i < errors.size(); i++) {
+        absErrors.append(fabs(errors[i]));
+
+        if (errors[i] < -SYNC_HISTOGRAM_RANGE) {
+            underflow++;
+        } else if (errors[i] >= SYNC_HISTOGRAM_RANGE) {
+            overflow++;
+        } else {
+            bins[static_cast<int>(floor((errors[i] + SYNC_HISTOGRAM_RANGE) / SYNC_HISTOGRAM_BIN))]++;
+        }
+    }
+
+    for (int i = 0; i < bins.size(); i++) {
+        counts.append(bins[i]);
+    }
+
+    std::sort(absErrors.begin(), absErrors.end());
+
+    // counts[i] 为 [from_ms + i * bin_ms, from_ms + (i + 1) * bin_ms) 内的次数
+    histogram["from_ms"]    = -SYNC_HISTOGRAM_RANGE;
+    histogram["bin_ms"]     = SYNC_HISTOGRAM_BIN;
+    histogram["counts"]     = counts;
+    histogram["underflow"]  = underflow;
+    histogram["overflow"]   = overflow;
+
+    double maxError = absErrors.isEmpty() ? 0 : absErrors.last();
+
+    result["clips"]         = clipReports;
+    result["matched"]       = errors.size();
+    result["unmatched"]     = unmatched;
+    result["p50_abs_ms"]    = absErrors.isEmpty() ? 0 : absErrors[(absErrors.size() - 1) / 2];
+    result["p95_abs_ms"]    = absErrors.isEmpty() ? 0 : absErrors[qMin(absErrors.size() - 1, static_cast<int>(absErrors.size() * 0.95))];
+    result["max_abs_ms"]    = maxError;
+    result["tolerance_ms"]  = tolerance;
+    result["histogram"]     = histogram;
+    result["passed"]        = !errors.isEmpty() && unmatched == 0 && maxError <= tolerance;
+
+    return result;
+}
+
+/**
+ * @brief 音视频同步精度测试入口
+ * @note  用法：FFmpegQtPlayer --sync-test [--rates 24000/1001,25,30,60] [--tolerance 毫秒] [--output 报告文件]
+ *        误差为同一事件闪白的取帧时刻减去提示音的输出时刻，输出时刻为音频回调时刻加上实际打开的设备缓冲区时长；
+ *        全部配对且最大误差不超过容差时返回 0，否则返回 2
+ */
+int runSyncTest(int argc, char *argv[])
+{
+    // 没有声卡的测试机上使用 SDL 的 dummy 音频驱动（按实时速度消费数据），已设置时（如 disk）保持不变
+    if (qEnvironmentVariableIsEmpty("SDL_AUDIODRIVER")) {
+        qputenv("SDL_AUDIODRIVER", "dummy");
+    }
+
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption syncTestOption("sync-test", "Measure audio/video sync accuracy on generated clips.");
+    QCommandLineOption ratesOption("rates", "Comma separated video frame rates to test.", "rates", "24000/1001,25,30,60");
+    QCommandLineOption toleranceOption("tolerance", "Maximum allowed absolute A/V error in milliseconds.", "ms", "40");
+    QCommandLineOption outputOption("output", "Write the JSON report to this file instead of stdout.", "file");
+    parser.addOption(syncTestOption);
+    parser.addOption(ratesOption);
+    parser.addOption(toleranceOption);
+    parser.addOption(outputOption);
+    parser.process(a);
+
+    QList<AVRational> frameRates;
+    QStringList rates = parser.value(ratesOption).split(',', QString::SkipEmptyParts);
+
+    for (int i = 0; i < rates.size(); i++) {
+        AVRational rate;
+        if (av_parse_video_rate(&rate, rates[i].trimmed().toLatin1().data()) < 0) {
+            qDebug() << "Invalid frame rate:" << rates[i];
+            return 1;
+        }
+        frameRates.append(rate);
+    }
+
+    if (frameRates.isEmpty()) {
+        return 1;
+    }
+
+    // 与 MainWindow::initFFmpeg 相同的初始化
+    avfilter_register_all();
+    av_register_all();
+    avformat_network_init();
+
+    if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_TIMER)) {
+        qDebug() << "SDL init failed";
+        return 1;
+    }
+
+    qRegisterMetaType<MainDecoder::PlayState>("MainDecoder::PlayState");
+
+    int ret = 1;
+    {
+        SyncTestRunner runner(frameRates, parser.value(toleranceOption).toDouble());
+        runner.setOutputFile(parser.value(outputOption));
+
+        if (runner.prepare()) {
+            runner.start();
+            ret = a.exec();
+        }
+    }
+
+#ifdef ENABLE_TRACE
+    Tracer::dumpFromEnvironment();
+#endif
+
+    SDL_Quit();
+
+    return ret;
+}
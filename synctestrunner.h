@@ -0,0 +1,87 @@
+#ifndef SYNCTESTRUNNER_H
+#define SYNCTESTRUNNER_H
+
+#include <QObject>
+#include <QImage>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QTimer>
+#include <QTemporaryDir>
+
+#include "maindecoder.h"
+
+/* 每个片段最多记录的提示音起点数 */
+#define SYNC_MAX_ONSETS 1024
+
+/* 音视频同步精度测试：生成每秒一次闪白 + 提示音的测试片段（两者时间戳相同），
+ * 用真实的 MainDecoder / AudioDecoder 按实时速度播放，界面线程取帧检测闪白、音频回调监听检测提示音，
+ * 比较两者实际输出时刻的差值；播放过程中会暂停和前后跳转，并对每种帧率分别测试，
+ * 最后以 JSON 输出误差直方图，超出容差时返回非零值
+ */
+class SyncTestRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SyncTestRunner(const QList<AVRational> &frameRates, double tolerance, QObject *parent = nullptr);
+    ~SyncTestRunner();
+
+    bool prepare();
+    void start();
+    void setOutputFile(const QString &file);
+
+private slots:
+    void takeVideo();
+    void playStateChanged(MainDecoder::PlayState state);
+    void runAction();
+    void timeout();
+
+private:
+    /* 检测到第 N 次闪白之后执行的操作 */
+    enum Action {
+        ACTION_NONE,
+        ACTION_PAUSE,
+        ACTION_RESUME,
+        ACTION_SEEK_BACKWARD,
+        ACTION_SEEK_FORWARD
+    };
+
+    static void audioTap(void *opaque, const SDL_AudioSpec *spec, const quint8 *data, int size, qint64 callbackTime);
+    void detectBeeps(const SDL_AudioSpec *spec, const quint8 *data, int size, qint64 callbackTime);
+    void startClip();
+    void finishClip();
+    QJsonObject report();
+
+    MainDecoder *decoder;
+
+    QList<AVRational> frameRates;   // 每种帧率生成一个片段
+    QStringList clipFiles;
+    QTemporaryDir clipDir;
+    double tolerance;               // 允许的最大误差（毫秒）
+    QString outputFile;             // 为空时输出到标准输出
+
+    int clipIndex;                  // 正在播放的片段
+    bool isStopping;                // 片段已播放完或超时，等待停止
+    bool isTimedOut;
+
+    QTimer actionTimer;
+    QTimer watchdog;                // 片段播放超时
+    Action pendingAction;
+
+    /* 提示音起点（av_gettime_relative，微秒），音频回调写入、界面线程在片段结束后读取 */
+    qint64 beepOnsets[SYNC_MAX_ONSETS];
+    QAtomicInt beepCount;
+    qint64 lastLoudTime;            // 最近一个有声采样的输出时刻（音频线程）
+
+    QVector<qint64> flashOnsets;    // 闪白起点（界面线程）
+    bool isFlashing;
+
+    QVector<double> errors;         // 所有片段的误差（毫秒），正值表示画面晚于声音
+    QJsonArray clipReports;
+    int unmatched;                  // 所有片段中没有配对的闪白和提示音数
+
+    QImage image;
+};
+
+int runSyncTest(int argc, char *argv[]);
+
+#endif // SYNCTESTRUNNER_H
@@ -0,0 +1,464 @@
+﻿#include <QFileInfo>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+
+extern "C"
+{
+#include "libavutil/time.h"
+}
+
+#include "thumbnailprovider.h"
+#include "tracer.h"
+
+#define THUMB_CACHE_VERSION 1
+/* 跳转后最多读取的包数，找不到关键帧时放弃，避免损坏的文件一直读下去 */
+#define THUMB_MAX_PACKETS   500
+
+ThumbnailProvider::ThumbnailProvider(QObject *parent) :
+    QObject(parent),
+    fileSize(0),
+    formatCtx(nullptr),
+    codecCtx(nullptr),
+    swsCtx(nullptr),
+    frame(nullptr),
+    videoIndex(-1),
+    tileWidth(0),
+    tileHeight(0),
+    cache(THUMB_CACHE_SIZE),
+    pendingSecond(-1),
+    isDirty(false),
+    tid(nullptr),
+    saveTid(nullptr),
+    isAbort(0)
+{
+    mutex   = SDL_CreateMutex();
+    cond    = SDL_CreateCond();
+}
+
+ThumbnailProvider::~ThumbnailProvider()
+{
+    close();
+    waitSave();
+
+    SDL_DestroyCond(cond);
+    SDL_DestroyMutex(mutex);
+}
+
+/**
+ * @brief 为本地视频文件启动缩略图线程，之前打开的文件先关闭（保存缓存）
+ * @param file 本地文件路径
+ */
+void ThumbnailProvider::open(const QString &file)
+{
+    QFileInfo info(file);
+
+    close();
+
+    if (!info.isFile()) {
+        return;
+    }
+
+    this->file      = file;
+    this->fileSize  = info.size();
+
+    // 文件标识：绝对路径 + 大小 + 修改时间，任一变化都重新生成缩略图
+    QByteArray identity = QString("%1|%2|%3").arg(info.absoluteFilePath()).arg(info.size())
+            .arg(info.lastModified().toMSecsSinceEpoch()).toUtf8();
+    QString name = QCryptographicHash::hash(identity, QCryptographicHash::Sha1).toHex();
+
+    cachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails/" + name + ".thc";
+
+    isAbort = 0;
+    tid = SDL_CreateThread(&ThumbnailProvider::decodeThread, "thumbnail", this);
+}
+
+// 停止缩略图线程，有新图块时在后台保存缓存，然后清空
+void ThumbnailProvider::close()
+{
+    isAbort = 1;
+
+    if (tid) {
+        SDL_LockMutex(mutex);
+        SDL_CondSignal(cond);
+        SDL_UnlockMutex(mutex);
+
+        SDL_WaitThread(tid, NULL);
+        tid = nullptr;
+
+        if (isDirty) {
+            startSave();
+        }
+    }
+
+    SDL_LockMutex(mutex);
+    cache.clear();
+    pendingSecond   = -1;
+    isDirty         = false;
+    SDL_UnlockMutex(mutex);
+}
+
+/**
+ * @brief 取某一秒的缩略图（界面线程）
+ * @param second 进度条位置（秒）
+ * @param image  返回缩略图
+ * @return false 还没有缓存，已请求后台解码，完成后发出 thumbnailReady()
+ */
+bool ThumbnailProvider::thumbnail(int second, QImage *image)
+{
+    bool isCached = false;
+
+    if (!tid || second < 0) {
+        return false;
+    }
+
+    SDL_LockMutex(mutex);
+
+    QImage *cached = cache.object(second);
+    if (cached) {
+        *image = *cached;
+        isCached = true;
+    } else {
+        // 只保留最新的请求
+        pendingSecond = second;
+        SDL_CondSignal(cond);
+    }
+
+    SDL_UnlockMutex(mutex);
+
+    return isCached;
+}
+
+int ThumbnailProvider::decodeThread(void *arg)
+{
+    ThumbnailProvider *provider = (ThumbnailProvider *)arg;
+
+    TRACE_THREAD_NAME("thumbnail");
+
+    // 与播放争用 I/O 和 CPU 时让出
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    if (!provider->openInput()) {
+        provider->closeInput();
+        return 0;
+    }
+
+    provider->load();
+
+    while (!provider->isAbort) {
+        int second;
+        bool isCached;
+        QImage image;
+
+        SDL_LockMutex(provider->mutex);
+        while (provider->pendingSecond < 0 && !provider->isAbort) {
+            SDL_CondWait(provider->cond, provider->mutex);
+        }
+        second = provider->pendingSecond;
+        provider->pendingSecond = -1;
+        isCached = provider->cache.contains(second);
+        SDL_UnlockMutex(provider->mutex);
+
+        if (provider->isAbort) {
+            break;
+        }
+
+        if (isCached || !provider->decodeThumbnail(second, &image)) {
+            continue;
+        }
+
+        SDL_LockMutex(provider->mutex);
+        provider->cache.insert(second, new QImage(image));
+        provider->isDirty = true;
+        SDL_UnlockMutex(provider->mutex);
+
+        emit provider->thumbnailReady(second);
+    }
+
+    provider->closeInput();
+
+    return 0;
+}
+
+int ThumbnailProvider::interruptCallback(void *arg)
+{
+    return static_cast<ThumbnailProvider *>(arg)->isAbort.loadAcquire();
+}
+
+// 打开文件和视频解码器（缩略图线程），只解码关键帧，其它流设为丢弃
+bool ThumbnailProvider::openInput()
+{
+    AVCodec *codec;
+    AVStream *stream;
+    AVRational sar;
+
+    formatCtx = avformat_alloc_context();
+    formatCtx->interrupt_callback.callback  = &ThumbnailProvider::interruptCallback;
+    formatCtx->interrupt_callback.opaque    = this;
+
+    if (avformat_open_input(&formatCtx, file.toLocal8Bit().data(), NULL, NULL) != 0) {
+        return false;
+    }
+
+    if (avformat_find_stream_info(formatCtx, NULL) < 0) {
+        return false;
+    }
+
+    videoIndex = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (videoIndex < 0) {
+        return false;
+    }
+    stream = formatCtx->streams[videoIndex];
+
+    // 封面图片没有时间轴，不生成缩略图
+    if (stream->disposition & AV_DISPOSITION_ATTACHED_PIC) {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < formatCtx->nb_streams; i++) {
+        formatCtx->streams[i]->discard = static_cast<int>(i) == videoIndex ? AVDISCARD_NONKEY : AVDISCARD_ALL;
+    }
+
+    codecCtx = avcodec_alloc_context3(NULL);
+    avcodec_parameters_to_context(codecCtx, stream->codecpar);
+
+    if ((codec = avcodec_find_decoder(codecCtx->codec_id)) == NULL) {
+        return false;
+    }
+
+    // 单线程解码，不与播放抢占 CPU，也没有多线程解码的输出延迟
+    codecCtx->thread_count  = 1;
+    codecCtx->skip_frame    = AVDISCARD_NONKEY;
+
+    if (avcodec_open2(codecCtx, codec, NULL) < 0) {
+        return false;
+    }
+
+    // 图块高度按显示宽高比计算，取偶数
+    sar = av_guess_sample_aspect_ratio(formatCtx, stream, NULL);
+    if (sar.num <= 0 || sar.den <= 0) {
+        sar = av_make_q(1, 1);
+    }
+    if (codecCtx->width <= 0 || codecCtx->height <= 0) {
+        return false;
+    }
+
+    tileWidth   = THUMB_WIDTH;
+    tileHeight  = static_cast<int>(av_rescale(THUMB_WIDTH, static_cast<qint64>(codecCtx->height) * sar.den,
+                                              static_cast<qint64>(codecCtx->width) * sar.num)) & ~1;
+    tileHeight  = qBound(16, tileHeight, THUMB_WIDTH * 2);
+
+    frame = av_frame_alloc();
+
+    return true;
+}
+
+void ThumbnailProvider::closeInput()
+{
+    if (swsCtx) {
+        sws_freeContext(swsCtx);
+        swsCtx = nullptr;
+    }
+
+    av_frame_free(&frame);
+    avcodec_free_context(&codecCtx);
+    avformat_close_input(&formatCtx);
+
+    videoIndex = -1;
+}
+
+/**
+ * @brief 解码请求时间之前最近的关键帧并缩放成图块（缩略图线程）
+ * @param second 进度条位置（秒）
+ * @param image  返回图块
+ */
+bool ThumbnailProvider::decodeThumbnail(int second, QImage *image)
+{
+    AVPacket packet;
+    qint64 target = static_cast<qint64>(second) * AV_TIME_BASE;
+    qint64 start = av_gettime_relative();
+    bool isDecoded = false;
+    int ret;
+
+    TRACE_SCOPE("thumbnail");
+
+    // 与 MainDecoder::doSeek 相同，进度条位置直接作为时间戳，不加 start_time
+    if (av_seek_frame(formatCtx, -1, target, AVSEEK_FLAG_BACKWARD) < 0) {
+        return false;
+    }
+    avcodec_flush_buffers(codecCtx);
+
+    for (int i = 0; i < THUMB_MAX_PACKETS && !isDecoded && !isAbort; i++) {
+        if (av_read_frame(formatCtx, &packet) < 0) {
+            break;
+        }
+
+        if (packet.stream_index != videoIndex) {
+            av_packet_unref(&packet);
+            continue;
+        }
+
+        ret = avcodec_send_packet(codecCtx, &packet);
+        av_packet_unref(&packet);
+        if (ret < 0) {
+            continue;
+        }
+
+        ret = avcodec_receive_frame(codecCtx, frame);
+        if (ret == AVERROR(EAGAIN)) {
+            // 有输出延迟的解码器：冲刷出这一帧，之后重新开始
+            avcodec_send_packet(codecCtx, NULL);
+            ret = avcodec_receive_frame(codecCtx, frame);
+            avcodec_flush_buffers(codecCtx);
+        }
+
+        isDecoded = ret == 0;
+    }
+
+    if (!isDecoded) {
+        return false;
+    }
+
+    swsCtx = sws_getCachedContext(swsCtx, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                                  tileWidth, tileHeight, AV_PIX_FMT_RGB24, SWS_BILINEAR, NULL, NULL, NULL);
+    if (!swsCtx) {
+        av_frame_unref(frame);
+        return false;
+    }
+
+    *image = QImage(tileWidth, tileHeight, QImage::Format_RGB888);
+
+    uint8_t *dstData[4]     = {image->bits(), NULL, NULL, NULL};
+    int dstLinesize[4]      = {image->bytesPerLine(), 0, 0, 0};
+
+    sws_scale(swsCtx, frame->data, frame->linesize, 0, frame->height, dstData, dstLinesize);
+    av_frame_unref(frame);
+
+    TRACE_COUNTER("thumbnail_decode_ms", (av_gettime_relative() - start) / 1000);
+
+    return true;
+}
+
+// 载入缓存文件（缩略图线程），头部与文件或图块尺寸不符时忽略
+void ThumbnailProvider::load()
+{
+    Header header;
+    QFile input(cachePath);
+    int rowSize = tileWidth * 3;
+
+    if (!input.open(QFile::ReadOnly)
+            || input.read(reinterpret_cast<char *>(&header), sizeof(header)) != static_cast<qint64>(sizeof(header))) {
+        return;
+    }
+
+    if (memcmp(header.magic, "FQTH", 4) != 0 || header.version != THUMB_CACHE_VERSION
+            || header.width != tileWidth || header.height != tileHeight || header.fileSize != fileSize
+            || header.count <= 0 || header.count > THUMB_CACHE_SIZE
+            || input.size() != static_cast<qint64>(sizeof(Header) + header.count * (sizeof(qint32) + rowSize * tileHeight))) {
+        return;
+    }
+
+    SDL_LockMutex(mutex);
+    for (qint64 i = 0; i < header.count; i++) {
+        qint32 second;
+        QImage *image = new QImage(tileWidth, tileHeight, QImage::Format_RGB888);
+
+        input.read(reinterpret_cast<char *>(&second), sizeof(second));
+        for (int y = 0; y < tileHeight; y++) {
+            input.read(reinterpret_cast<char *>(image->scanLine(y)), rowSize);
+        }
+        cache.insert(second, image);
+    }
+    SDL_UnlockMutex(mutex);
+
+    qDebug() << "Thumbnail cache loaded:" << header.count << "thumbnails";
+}
+
+/**
+ * @brief 取缓存的快照，启动保存线程（界面线程，缩略图线程已退出）
+ * @note  上一次的保存还没结束时先等它完成，两次保存可能写同一个文件
+ */
+void ThumbnailProvider::startSave()
+{
+    SaveJob *job = new SaveJob;
+
+    waitSave();
+
+    job->path       = cachePath;
+    job->fileSize   = fileSize;
+    job->width      = tileWidth;
+    job->height     = tileHeight;
+
+    SDL_LockMutex(mutex);
+    job->seconds = cache.keys();
+    for (int i = 0; i < job->seconds.size(); i++) {
+        job->images.append(*cache.object(job->seconds.at(i)));
+    }
+    SDL_UnlockMutex(mutex);
+
+    saveTid = SDL_CreateThread(&ThumbnailProvider::saveThread, "thumbnail_save", job);
+    if (!saveTid) {
+        delete job;
+    }
+}
+
+// 等待正在进行的保存完成
+void ThumbnailProvider::waitSave()
+{
+    if (saveTid) {
+        SDL_WaitThread(saveTid, NULL);
+        saveTid = nullptr;
+    }
+}
+
+int ThumbnailProvider::saveThread(void *arg)
+{
+    SaveJob *job = (SaveJob *)arg;
+
+    TRACE_THREAD_NAME("thumbnail_save");
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    save(*job);
+    delete job;
+
+    return 0;
+}
+
+// 保存缓存快照（保存线程），先写临时文件再替换，不会留下不完整的缓存
+void ThumbnailProvider::save(const SaveJob &job)
+{
+    Header header;
+    QSaveFile output(job.path);
+    int rowSize = job.width * 3;
+
+    if (job.seconds.isEmpty() || !QDir().mkpath(QFileInfo(job.path).path()) || !output.open(QFile::WriteOnly)) {
+        return;
+    }
+
+    memcpy(header.magic, "FQTH", 4);
+    header.version  = THUMB_CACHE_VERSION;
+    header.width    = job.width;
+    header.height   = job.height;
+    header.fileSize = job.fileSize;
+    header.count    = job.seconds.size();
+
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (int i = 0; i < job.seconds.size(); i++) {
+        qint32 second = job.seconds.at(i);
+        const QImage &image = job.images.at(i);
+
+        output.write(reinterpret_cast<const char *>(&second), sizeof(second));
+        for (int y = 0; y < job.height; y++) {
+            output.write(reinterpret_cast<const char *>(image.constScanLine(y)), rowSize);
+        }
+    }
+
+    if (!output.commit()) {
+        qDebug() << "Save thumbnail cache failed:" << job.path;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef THUMBNAILPROVIDER_H
+#define THUMBNAILPROVIDER_H
+
+#include <QObject>
+#include <QString>
+#include <QImage>
+#include <QCache>
+#include <QList>
+#include <QAtomicInt>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libswscale/swscale.h"
+}
+
+#include "SDL2/SDL.h"
+
+/* 缩略图宽度（像素），高度按显示宽高比计算 */
+#define THUMB_WIDTH         160
+/* 内存中最多缓存的缩略图数，超出时淘汰最久未使用的 */
+#define THUMB_CACHE_SIZE    600
+
+/* 进度条悬停缩略图：后台低优先级线程用独立的 AVFormatContext 和解码器打开同一个文件，
+ * 按需跳转到请求时间之前最近的关键帧，只解码这一帧并缩放成小的 RGB 图块，放入 LRU 缓存。
+ * 请求只保留最新的一个，鼠标快速划过时中间位置直接跳过；与播放的解复用循环不共享任何状态。
+ *
+ * 缓存在关闭时由单独的线程保存到缓存目录的旁路文件中（不阻塞界面线程），
+ * 以文件路径、大小和修改时间作为标识，再次打开同一文件时直接载入
+ */
+class ThumbnailProvider : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThumbnailProvider(QObject *parent = nullptr);
+    ~ThumbnailProvider();
+
+    void open(const QString &file);
+    void close();
+    bool thumbnail(int second, QImage *image);
+
+signals:
+    void thumbnailReady(int second);
+
+private:
+    struct Header {
+        char magic[4];          // "FQTH"
+        quint32 version;
+        qint32 width;           // 图块尺寸
+        qint32 height;
+        qint64 fileSize;
+        qint64 count;           // 图块数，之后每个图块为 qint32 秒数 + RGB888 像素
+    };
+
+    /* 关闭时的缓存快照，交给保存线程写入文件 */
+    struct SaveJob {
+        QString path;
+        qint64 fileSize;
+        int width;
+        int height;
+        QList<int> seconds;
+        QList<QImage> images;   // 与 seconds 一一对应，隐式共享，不拷贝像素
+    };
+
+    static int decodeThread(void *arg);
+    static int interruptCallback(void *arg);
+    bool openInput();
+    void closeInput();
+    bool decodeThumbnail(int second, QImage *image);
+    void load();
+    void startSave();
+    void waitSave();
+    static int saveThread(void *arg);
+    static void save(const SaveJob &job);
+
+    QString file;
+    QString cachePath;          // 旁路缓存文件
+    qint64 fileSize;
+
+    /* 解码上下文，只在缩略图线程中使用 */
+    AVFormatContext *formatCtx;
+    AVCodecContext *codecCtx;
+    SwsContext *swsCtx;
+    AVFrame *frame;
+    int videoIndex;
+    int tileWidth;
+    int tileHeight;
+
+    /* 缓存和请求，由 mutex 保护 */
+    QCache<int, QImage> cache;
+    int pendingSecond;          // 等待解码的请求，-1 表示没有
+    bool isDirty;               // 有新解码的图块，关闭时需要保存
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+
+    SDL_Thread *tid;            // 缩略图线程
+    SDL_Thread *saveTid;        // 保存缓存的线程，同一时刻最多一个
+    QAtomicInt isAbort;
+};
+
+#endif // THUMBNAILPROVIDER_H
@@ -0,0 +1,208 @@
+﻿#include "tracer.h"
+
+#ifdef ENABLE_TRACE
+
+#include <QAtomicInteger>
+#include <QFile>
+#include <QList>
+#include <QTextStream>
+#include <QVector>
+#include <QDebug>
+
+extern "C"
+{
+#include "libavutil/time.h"
+}
+
+#include "SDL2/SDL.h"
+
+/* 每个线程保留最近的事件数（必须为 2 的幂），每个事件 32 字节，每个线程 2 MB */
+#define TRACE_BUFFER_SIZE   (1 << 16)
+
+/* 设置该环境变量（导出文件路径）时，程序退出前自动导出 */
+#define TRACE_ENV_VAR       "FFMPEGQTPLAYER_TRACE"
+
+struct TraceEvent {
+    const char *name;
+    qint64 time;            // av_gettime_relative，微秒
+    qint64 value;           // 计数器事件的值
+    char phase;             // B 开始、E 结束、C 计数器
+};
+
+/* 单个线程的事件缓冲区：只有所属线程写入，导出时由其它线程读取 */
+struct TraceBuffer {
+    TraceEvent events[TRACE_BUFFER_SIZE];
+    QAtomicInteger<quint32> count;      // 累计写入的事件数（单调递增）
+    quint64 tid;
+    const char *threadName;
+    QAtomicInt inUse;                   // 所属线程仍在运行
+};
+
+// 所有线程的缓冲区，只在线程第一次记录和导出时加锁
+static QList<TraceBuffer *> traceBuffers;
+
+static SDL_mutex *registryMutex()
+{
+    static SDL_mutex *mutex = SDL_CreateMutex();
+    return mutex;
+}
+
+// 线程退出时释放缓冲区的所有权，留给之后新建的线程复用（每次打开文件都会新建解码线程）
+struct TraceBufferHolder {
+    TraceBuffer *buffer = nullptr;
+
+    ~TraceBufferHolder()
+    {
+        if (buffer) {
+            buffer->inUse.storeRelease(0);
+        }
+    }
+};
+
+static thread_local TraceBufferHolder traceHolder;
+
+static TraceBuffer *threadBuffer()
+{
+    if (traceHolder.buffer) {
+        return traceHolder.buffer;
+    }
+
+    TraceBuffer *buffer = nullptr;
+
+    SDL_LockMutex(registryMutex());
+    for (TraceBuffer *candidate : traceBuffers) {
+        if (candidate->inUse.testAndSetOrdered(0, 1)) {
+            buffer = candidate;
+            break;
+        }
+    }
+
+    if (!buffer) {
+        buffer = new TraceBuffer;
+        buffer->inUse.storeRelease(1);
+        traceBuffers.append(buffer);
+    }
+
+    // 复用的缓冲区丢弃已退出线程的事件
+    buffer->count.storeRelease(0);
+    buffer->tid         = SDL_ThreadID();
+    buffer->threadName  = nullptr;
+    SDL_UnlockMutex(registryMutex());
+
+    traceHolder.buffer = buffer;
+
+    return buffer;
+}
+
+static void record(const char *name, char phase, qint64 value)
+{
+    TraceBuffer *buffer = threadBuffer();
+
+    // 只有本线程写 count，可以直接读取
+    quint32 index = buffer->count.load();
+    TraceEvent &event = buffer->events[index & (TRACE_BUFFER_SIZE - 1)];
+    event.name  = name;
+    event.time  = av_gettime_relative();
+    event.value = value;
+    event.phase = phase;
+
+    // 发布事件，导出线程只读取 count 之前的事件
+    buffer->count.storeRelease(index + 1);
+}
+
+void Tracer::begin(const char *name)
+{
+    record(name, 'B', 0);
+}
+
+void Tracer::end(const char *name)
+{
+    record(name, 'E', 0);
+}
+
+// 计数器（如队列深度），在追踪视图中显示为折线
+void Tracer::counter(const char *name, qint64 value)
+{
+    record(name, 'C', value);
+}
+
+// 设置当前线程在追踪视图中显示的名字
+void Tracer::setThreadName(const char *name)
+{
+    threadBuffer()->threadName = name;
+}
+
+/**
+ * @brief 导出所有线程最近的事件，可以在播放过程中随时调用
+ * @note  读取时所属线程可能正在覆盖最早的事件，复制后重新读取 count，丢弃可能已被覆盖的部分
+ */
+bool Tracer::dump(const QString &file)
+{
+    QFile output(file);
+    if (!output.open(QFile::WriteOnly | QFile::Truncate)) {
+        qDebug() << "Open trace file failed:" << file;
+        return false;
+    }
+
+    QTextStream stream(&output);
+    QVector<TraceEvent> events(TRACE_BUFFER_SIZE);
+    bool isFirst = true;
+    int total = 0;
+
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    // 加锁防止导出期间缓冲区被新线程复用
+    SDL_LockMutex(registryMutex());
+    for (TraceBuffer *buffer : traceBuffers) {
+        quint32 end     = buffer->count.loadAcquire();
+        quint32 start   = end > TRACE_BUFFER_SIZE ? end - TRACE_BUFFER_SIZE : 0;
+
+        for (quint32 i = start; i < end; i++) {
+            events[i - start] = buffer->events[i & (TRACE_BUFFER_SIZE - 1)];
+        }
+
+        // 复制期间被覆盖的事件不可信；写线程可能正在写第 latest 个事件，它与第 latest - TRACE_BUFFER_SIZE 个共用一个槽位
+        quint32 latest = buffer->count.loadAcquire();
+        quint32 valid  = latest >= TRACE_BUFFER_SIZE ? qMax(latest + 1 - TRACE_BUFFER_SIZE, start) : start;
+
+        if (buffer->threadName) {
+            stream << (isFirst ? "" : ",\n")
+                   << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                   << ",\"args\":{\"name\":\"" << buffer->threadName << "\"}}";
+            isFirst = false;
+        }
+
+        for (quint32 i = valid; i < end; i++) {
+            const TraceEvent &event = events[i - start];
+
+            stream << (isFirst ? "" : ",\n")
+                   << "{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase
+                   << "\",\"ts\":" << event.time << ",\"pid\":1,\"tid\":" << buffer->tid;
+            if (event.phase == 'C') {
+                stream << ",\"args\":{\"value\":" << event.value << "}";
+            }
+            stream << "}";
+            isFirst = false;
+            total++;
+        }
+    }
+    SDL_UnlockMutex(registryMutex());
+
+    stream << "\n]}\n";
+
+    qDebug() << "Trace exported:" << file << "," << total << "events";
+
+    return true;
+}
+
+// 设置了环境变量时导出到该路径（程序退出前调用）
+void Tracer::dumpFromEnvironment()
+{
+    QString file = QString::fromLocal8Bit(qgetenv(TRACE_ENV_VAR));
+
+    if (!file.isEmpty()) {
+        dump(file);
+    }
+}
+
+#endif // ENABLE_TRACE
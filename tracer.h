@@ -0,0 +1,59 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+
+/* 管线活动追踪，导出为 Chrome trace-event JSON（可在 chrome://tracing 或 ui.perfetto.dev 中打开）
+ * 只有定义了 ENABLE_TRACE（qmake CONFIG+=trace）时才编译进来，否则下面的宏展开为空语句，没有任何开销。
+ * 每个线程写自己的环形缓冲区，记录一个事件只有一次原子写，不加锁；缓冲区写满后覆盖最早的事件。
+ * 事件名必须是字符串常量（只保存指针）。
+ */
+#ifdef ENABLE_TRACE
+
+class Tracer
+{
+public:
+    static void begin(const char *name);
+
+    static void end(const char *name);
+
+    static void counter(const char *name, qint64 value);
+
+    static void setThreadName(const char *name);
+
+    static bool dump(const QString &file);
+
+    static void dumpFromEnvironment();
+};
+
+// 作用域内的一段活动，构造时开始、析构时结束
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) : name(name) { Tracer::begin(name); }
+    ~TraceScope() { Tracer::end(name); }
+
+private:
+    const char *name;
+};
+
+#define TRACE_CONCAT_(a, b)         a##b
+#define TRACE_CONCAT(a, b)          TRACE_CONCAT_(a, b)
+
+#define TRACE_SCOPE(name)           TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_BEGIN(name)           Tracer::begin(name)
+#define TRACE_END(name)             Tracer::end(name)
+#define TRACE_COUNTER(name, value)  Tracer::counter(name, value)
+#define TRACE_THREAD_NAME(name)     Tracer::setThreadName(name)
+
+#else
+
+#define TRACE_SCOPE(name)           do {} while (0)
+#define TRACE_BEGIN(name)           do {} while (0)
+#define TRACE_END(name)             do {} while (0)
+#define TRACE_COUNTER(name, value)  do {} while (0)
+#define TRACE_THREAD_NAME(name)     do {} while (0)
+
+#endif // ENABLE_TRACE
+
+#endif // TRACER_H
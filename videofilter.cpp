@@ -0,0 +1,159 @@
+﻿#include <QDebug>
+
+extern "C"
+{
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+}
+
+#include "videofilter.h"
+
+/**
+ * @brief 创建滤镜图：buffer -> desc -> buffersink
+ * @param desc        滤镜描述，空字符串表示直接连接源和汇
+ * @param width       输入宽度
+ * @param height      输入高度
+ * @param pixFmt      输入像素格式
+ * @param timeBase    输入帧的时间基
+ * @param sar         输入的像素宽高比
+ * @param isRgbOutput 限定输出为 RGB32（与 QImage 的 ARGB32 内存布局一致）
+ * @return 失败时返回负的错误码，filter 不需要释放
+ */
+int createVideoFilter(VideoFilterGraph *filter, const QString &desc, int width, int height,
+                      AVPixelFormat pixFmt, AVRational timeBase, AVRational sar, bool isRgbOutput)
+{
+    int ret;
+    QString args;
+
+    AVFilterInOut *out = avfilter_inout_alloc();
+    AVFilterInOut *in = avfilter_inout_alloc();
+    enum AVPixelFormat pixFmts[] = {AV_PIX_FMT_RGB32, AV_PIX_FMT_NONE};     // AV_PIX_FMT_NONE 类似字符串里的\0，结束变量
+
+    filter->src     = NULL;
+    filter->sink    = NULL;
+    // 分配新的graph
+    filter->graph   = avfilter_graph_alloc();
+
+    /* 输入格式参数
+     * video_size   width x height      视频的分辨率。滤镜需要知道画幅大小来分配内存或计算缩放。
+     * pix_fmt      像素格式（如 YUV420P, NV12）。这是滤镜最关心的，决定了数据如何排列。
+     * time_base    num / den           时间基准。用于将帧的 pts (时间戳) 转换为实际秒数，对时间相关的滤镜（如 fps 或 setpts）至关重要。
+     * pixel_aspect num / den           采样长宽比 (SAR)。告诉滤镜像素是正方形还是长方形，防止画面被拉伸变形。
+     */
+    args = QString("video_size=%1x%2:pix_fmt=%3:time_base=%4/%5:pixel_aspect=%6/%7")
+            .arg(width).arg(height).arg(av_get_pix_fmt_name(pixFmt))
+            .arg(timeBase.num).arg(timeBase.den)
+            .arg(sar.num).arg(sar.den);
+
+    // 创建源滤镜（输入滤镜），接收原始帧
+    ret = avfilter_graph_create_filter(&filter->src, avfilter_get_by_name("buffer"), "in", args.toLocal8Bit().data(), NULL, filter->graph);
+    if (ret < 0) {
+        qDebug() << "avfilter graph create filter failed, ret:" << ret;
+        goto fail;
+    }
+
+    // 创建汇滤镜（输出滤镜），输出处理后的帧
+    ret = avfilter_graph_create_filter(&filter->sink, avfilter_get_by_name("buffersink"), "out", NULL, NULL, filter->graph);
+    if (ret < 0) {
+        qDebug() << "avfilter graph create filter failed, ret:" << ret;
+        goto fail;
+    }
+
+    if (isRgbOutput) {
+        // 设置汇滤镜的输出格式为RGB32（显示传入 AV_PIX_FMT_NONE 结束变量）
+        ret = av_opt_set_int_list(filter->sink, "pix_fmts", pixFmts, AV_PIX_FMT_NONE, AV_OPT_SEARCH_CHILDREN);
+        if (ret < 0) {
+            qDebug() << "av opt set int list failed, ret:" << ret;
+            goto fail;
+        }
+    }
+
+    // 源滤镜是缓冲区的输出，是滤镜链的输入
+    out->name       = av_strdup("in");
+    out->filter_ctx = filter->src;
+    out->pad_idx    = 0;
+    out->next       = NULL;
+    // 汇滤镜是缓冲区的输入，是滤镜链的输出
+    in->name       = av_strdup("out");
+    in->filter_ctx = filter->sink;
+    in->pad_idx    = 0;
+    in->next       = NULL;
+
+    if (desc.isEmpty()) {
+        // 没有滤镜，直接把源和汇连起来，graph 配置时会自动插入像素格式转换
+        ret = avfilter_link(filter->src, 0, filter->sink, 0);
+        if (ret < 0) {
+            qDebug() << "avfilter link failed, ret:" << ret;
+            goto fail;
+        }
+    } else {
+        // 解析滤镜字符串，连接 source -> filter -> sink
+        ret = avfilter_graph_parse_ptr(filter->graph, desc.toLatin1().data(), &in, &out, NULL);
+        if (ret < 0) {
+            qDebug() << "avfilter graph parse ptr failed, filter:" << desc << ", ret:" << ret;
+            goto fail;
+        }
+    }
+
+    // 最终检查并配置整个滤镜图
+    if ((ret = avfilter_graph_config(filter->graph, NULL)) < 0) {
+        qDebug() << "avfilter graph config failed, filter:" << desc << ", ret:" << ret;
+        goto fail;
+    }
+
+    goto out;
+
+fail:
+    freeVideoFilter(filter);
+
+out:
+    // 释放资源
+    avfilter_inout_free(&out);
+    avfilter_inout_free(&in);
+
+    return ret;
+}
+
+void freeVideoFilter(VideoFilterGraph *filter)
+{
+    avfilter_graph_free(&filter->graph);
+    filter->src     = NULL;
+    filter->sink    = NULL;
+}
+
+/**
+ * @brief 输出级的缩放滤镜：按显示区域和长宽比模式缩放，与 RGB 转换在同一次 swscale 中完成
+ * @param width     输入宽度
+ * @param height    输入高度
+ * @param sar       输入的像素宽高比
+ * @param target    显示区域大小，为空时保持原始分辨率
+ * @param keepRatio 保持显示宽高比，否则拉伸填满显示区域
+ * @return 缩放滤镜描述，不需要缩放时返回空字符串
+ */
+QString outputScaleFilter(int width, int height, AVRational sar, QSize target, bool keepRatio)
+{
+    // 还不知道窗口大小，保持原始分辨率，由界面绘制时缩放
+    if (target.isEmpty()) {
+        return QString();
+    }
+
+    if (keepRatio) {
+        // 按显示宽高比（考虑非正方形像素）适配窗口，界面居中直接绘制
+        qint64 displayWidth = width;
+        if (sar.num > 0 && sar.den > 0) {
+            displayWidth = av_rescale(width, sar.num, sar.den);
+        }
+        target = QSize(displayWidth, height).scaled(target, Qt::KeepAspectRatio);
+    }
+
+    target = target.expandedTo(QSize(1, 1));
+
+    if (target.width() == width && target.height() == height && (sar.num == sar.den || sar.num == 0)) {
+        return QString();
+    }
+
+    return QString("scale=%1:%2:flags=bilinear,setsar=1").arg(target.width()).arg(target.height());
+}
@@ -0,0 +1,30 @@
+#ifndef VIDEOFILTER_H
+#define VIDEOFILTER_H
+
+#include <QString>
+#include <QSize>
+
+extern "C"
+{
+#include "libavfilter/avfilter.h"
+#include "libavutil/pixfmt.h"
+#include "libavutil/rational.h"
+}
+
+/* 视频滤镜图：buffer -> 滤镜链 -> buffersink
+ * 播放器（MainDecoder）和性能测试共用同一套创建代码，测试测量的就是实际播放时使用的滤镜图
+ */
+struct VideoFilterGraph {
+    AVFilterGraph   *graph;
+    AVFilterContext *src;
+    AVFilterContext *sink;
+};
+
+int createVideoFilter(VideoFilterGraph *filter, const QString &desc, int width, int height,
+                      AVPixelFormat pixFmt, AVRational timeBase, AVRational sar, bool isRgbOutput);
+
+void freeVideoFilter(VideoFilterGraph *filter);
+
+QString outputScaleFilter(int width, int height, AVRational sar, QSize target, bool keepRatio);
+
+#endif // VIDEOFILTER_H